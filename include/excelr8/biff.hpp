@@ -1,19 +1,25 @@
 #pragma once
 
+#include "excelr8/codec.hpp"
 #include "excelr8/data.hpp"
+#include <array>
+#include <cstdint>
 #include <fstream>
+#include <optional>
 #include <ostream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <tuple>
+#include <utility>
 #include <unordered_map>
-#include <unordered_set>
 #include <vector>
 
 namespace excelr8::biff {
 
 class dllexport Excelr8Error : public std::runtime_error {
     // An exception indicating problems reading data from an Excel file.
+    using std::runtime_error::runtime_error;
 };
 
 class BaseObject {
@@ -97,6 +103,7 @@ const int XL_CONDFMT = 0x01B0;
 const int XL_CONTINUE = 0x3c;
 const int XL_COUNTRY = 0x8C;
 const int XL_DATEMODE = 0x22;
+const int XL_DBCELL = 0xD7;
 const int XL_DEFAULTROWHEIGHT = 0x0225;
 const int XL_DEFCOLWIDTH = 0x55;
 const int XL_DIMENSION = 0x200;
@@ -191,20 +198,7 @@ const std::vector<int> bofcodes = { 0x0809, 0x0409, 0x0209, 0x0009 };
 
 const std::vector<int> XL_FORMULA_OPCODES = { 0x0006, 0x0406, 0x0206 };
 
-const std::unordered_set<int> _cell_opcode_set = {
-    XL_BOOLERR,
-    XL_FORMULA,
-    XL_FORMULA3,
-    XL_FORMULA4,
-    XL_LABEL,
-    XL_LABELSST,
-    XL_MULRK,
-    XL_NUMBER,
-    XL_RK,
-    XL_RSTRING,
-};
-
-const std::unordered_map<int, std::string> biff_rec_name_dict = {
+inline constexpr std::pair<int, std::string_view> biff_rec_names[] = {
     { 0x0000, "DIMENSIONS_B2" },
     { 0x0001, "BLANK_B2" },
     { 0x0002, "INTEGER_B2_ONLY" },
@@ -365,6 +359,85 @@ const std::unordered_map<int, std::string> biff_rec_name_dict = {
     { 0x0868, "RANGEPROTECTION" },
 };
 
+/// How the record loop should treat a record
+enum class record_class_t : uint8_t {
+    other,
+    bof,
+    eof,
+    continuation,
+    cell, // see is_cell_opcode()
+};
+
+/// Which cell handler a sheet parser dispatches a cell record to
+enum class record_handler_t : uint8_t {
+    none,
+    boolerr,
+    formula,
+    label,
+    labelsst,
+    mulrk,
+    number,
+    rk,
+    rstring,
+};
+
+inline constexpr std::pair<int, record_handler_t> cell_record_handlers[] = {
+    { XL_BOOLERR, record_handler_t::boolerr },
+    { XL_FORMULA, record_handler_t::formula },
+    { XL_FORMULA3, record_handler_t::formula },
+    { XL_FORMULA4, record_handler_t::formula },
+    { XL_LABEL, record_handler_t::label },
+    { XL_LABELSST, record_handler_t::labelsst },
+    { XL_MULRK, record_handler_t::mulrk },
+    { XL_NUMBER, record_handler_t::number },
+    { XL_RK, record_handler_t::rk },
+    { XL_RSTRING, record_handler_t::rstring },
+};
+
+/// One entry of the opcode table: 3 bytes, so the whole table fits in a
+/// few KB of L1/L2 and a lookup is a single indexed load.
+struct record_info_t {
+    uint8_t name = 0; // 1-based index into biff_rec_names, 0 if unknown
+    record_class_t cls = record_class_t::other;
+    record_handler_t handler = record_handler_t::none;
+};
+
+// Every known opcode is below 0x0900; anything above is treated as unknown
+constexpr int record_table_size = 0x0900;
+
+inline constexpr std::array<record_info_t, record_table_size> record_table = [] {
+    static_assert(std::size(biff_rec_names) < 256);
+    std::array<record_info_t, record_table_size> table {};
+    for (size_t i = 0; i < std::size(biff_rec_names); i++) {
+        table[biff_rec_names[i].first].name = static_cast<uint8_t>(i + 1);
+    }
+    for (auto opcode : { 0x0809, 0x0409, 0x0209, 0x0009 }) {
+        table[opcode].cls = record_class_t::bof;
+    }
+    table[XL_EOF].cls = record_class_t::eof;
+    table[XL_CONTINUE].cls = record_class_t::continuation;
+    for (const auto& [opcode, handler] : cell_record_handlers) {
+        table[opcode].cls = record_class_t::cell;
+        table[opcode].handler = handler;
+    }
+    return table;
+}();
+
+constexpr record_info_t record_info(int opcode)
+{
+    if (opcode < 0 or opcode >= record_table_size) {
+        return {};
+    }
+    return record_table[opcode];
+}
+
+/// Name of the record, or an empty view if the opcode is unknown
+constexpr std::string_view biff_rec_name(int opcode)
+{
+    auto name = record_info(opcode).name;
+    return name == 0 ? std::string_view() : biff_rec_names[name - 1].second;
+}
+
 const std::unordered_map<int, std::string> encoding_from_codepage {
     {1200 , "utf_16_le"},
     {10000, "mac_roman"},
@@ -391,16 +464,61 @@ const std::unordered_map<int, std::string> encoding_from_codepage {
     11 Gurmukhi [2]
 */
 
+/// Cell bounds a DIMENSIONS record gives
+struct dimensions_t {
+    uint32_t first_row;
+    /// One past the last row in use
+    uint32_t nrows;
+    uint16_t first_col;
+    /// One past the last column in use
+    uint16_t ncols;
+};
+
+/// Result of a FORMULA record, kept in the 8 bytes at offset 6
+struct formula_result_t {
+    enum class kind_t : uint8_t {
+        number,
+        string, // the text is in the STRING record that follows
+        boolean,
+        error,
+        empty_string,
+        unknown,
+    };
+    kind_t kind;
+    /// The number, 0 or 1, or the error code
+    double value;
+};
+
+/// Row and columns of a MULBLANK record
+struct mulblank_t {
+    uint16_t row;
+    uint16_t first_col;
+    /// Number of cells; the XF index of cell i is at offset 4 + 2 * i
+    size_t count;
+};
+
 dllexport bool is_cell_opcode(int c);
 dllexport void upkbits(void* tgt_obj, int src, std::vector<Manifest>& manifests);
 dllexport void upkbitsL(void* tgt_obj, int src, std::vector<Manifest>& manifests);
-dllexport std::string unpack_string(const data_t& data, int pos, const std::string& encoding, int lenlen);
-dllexport std::pair<std::string, int> unpack_string_update_pos(const data_t& data, int pos, const std::string& encoding, int lenlen, int known_len);
-dllexport std::string unpack_unicode(const data_t& data, int pos, int lenlen);
-dllexport std::pair<std::string, int> unpack_unicode_update_pos(const data_t& data, int pos, int lenlen, int known_len);
-dllexport int unpack_cell_range_address_list_update_pos(std::vector<pytype_H>& output_list, const data_t data, int pos, int addr_size);
-dllexport void hex_char_dump(const std::string& strg, int ofs, int dlen, int base, std::ostream& fout, bool unnumbered);
-dllexport void biff_dump(const data_t& mem, int stream_offset, int stream_len, int base, std::ostream& fout, bool unnumbered);
-dllexport void biff_count_records(const data_t& mem, int stream_offset, int stream_len, std::ostream& fout);
+dllexport std::string unpack_string(data_view_t data, int pos, const std::string& encoding, int lenlen);
+dllexport std::pair<std::string, int> unpack_string_update_pos(data_view_t data, int pos, const std::string& encoding, int lenlen, int known_len);
+// Same, with the encoding already resolved (Book::codec)
+dllexport std::string unpack_string(data_view_t data, int pos, const util::codec_t& codec, int lenlen);
+dllexport std::pair<std::string, int> unpack_string_update_pos(data_view_t data, int pos, const util::codec_t& codec, int lenlen, int known_len);
+dllexport std::string unpack_unicode(data_view_t data, int pos, int lenlen);
+dllexport std::pair<std::string, int> unpack_unicode_update_pos(data_view_t data, int pos, int lenlen, int known_len);
+dllexport int unpack_cell_range_address_list_update_pos(std::vector<pytype_H>& output_list, data_view_t data, int pos, int addr_size);
+/// Bounds from a DIMENSIONS record (32-bit rows from BIFF8 on); nullopt
+/// if it is too short.
+dllexport std::optional<dimensions_t> unpack_dimensions(data_view_t data, int biff_version);
+dllexport formula_result_t unpack_formula_result(data_view_t data);
+/// nullopt if the record has no cells (shorter than 8 bytes)
+dllexport std::optional<mulblank_t> mulblank_header(data_view_t data);
+/// Text of a LABEL or RSTRING (pos 6) or STRING (pos 0) record: Unicode
+/// from BIFF8 on, in the workbook's codepage before.
+dllexport std::string unpack_cell_text(data_view_t data, int pos, int biff_version, const util::codec_t& codec);
+dllexport void hex_char_dump(data_view_t strg, int ofs, int dlen, int base, std::ostream& fout, bool unnumbered);
+dllexport void biff_dump(data_view_t mem, int stream_offset, int stream_len, int base, std::ostream& fout, bool unnumbered);
+dllexport void biff_count_records(data_view_t mem, int stream_offset, int stream_len, std::ostream& fout);
 
 }
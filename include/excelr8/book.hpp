@@ -1,7 +1,17 @@
 #pragma once
 
+#include "excelr8/codec.hpp"
 #include "excelr8/name.hpp"
 #include "excelr8/formatting.hpp"
+#include "excelr8/record.hpp"
+#include "excelr8/rows.hpp"
+#include "excelr8/sheet.hpp"
+#include "excelr8/source.hpp"
+#include "excelr8/sst.hpp"
+#include "excelr8/stream.hpp"
+#include <memory>
+#include <memory_resource>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -15,6 +25,50 @@ namespace excelr8::formatting {
 
 namespace excelr8::book {
 
+/// A sheet as listed in the workbook globals, see Book::scan_info()
+struct sheet_info_t {
+    std::string name;
+
+    /// XL_BOUNDSHEET_WORKSHEET, XL_BOUNDSHEET_CHART, XL_BOUNDSHEET_VB_MODULE
+    /// or 1 for an Excel 4 macro sheet.
+    uint8_t type = biff::XL_BOUNDSHEET_WORKSHEET;
+
+    /// 0: visible; 1: hidden; 2: "very hidden".
+    uint8_t visibility = 0;
+
+    /// workbook_stream offset of the sheet's BOF record
+    uint64_t offset = 0;
+
+    /// From the sheet's DIMENSIONS record (worksheets only): the first
+    /// row and column in use and one past the last. All 0 if there is
+    /// no such record.
+    bool has_dimension = false;
+    uint32_t first_row = 0;
+    uint32_t nrows = 0;
+    uint32_t first_col = 0;
+    uint32_t ncols = 0;
+
+    /// Records read from the sheet: its BOF up to and including its
+    /// DIMENSIONS record, or up to its first row or cell without one.
+    size_t nrecords = 0;
+};
+
+/// What Book::scan_info() finds
+struct workbook_info_t {
+    int biff_version = 0;
+    int codepage = -1;
+    /// Derived from codepage, or encoding_override
+    std::string encoding;
+    int datemode = 0;
+    /// All sheets of every type, in workbook order
+    std::vector<sheet_info_t> sheets;
+    /// Records in the workbook globals, BOF to EOF, each CONTINUE
+    /// record counting as one
+    size_t nglobal_records = 0;
+    /// nglobal_records plus the nrecords of every sheet
+    size_t nrecords = 0;
+};
+
 /**
     Contents of a "workbook"
 
@@ -22,9 +76,17 @@ namespace excelr8::book {
         You should never instantiate this class yourself. You use the `Book`
         object that was returned when you called `excelr8::open_workbook()`.
 */
-class Book {
+class dllexport Book {
 
 public:
+    /// Workbook-lifetime storage for parse-time objects (color_map entries,
+    /// the compound document's tables, the shared string table, ...).
+    /// Everything allocated from it is released at once when the Book is
+    /// destroyed. It draws on the upstream resource the Book was
+    /// constructed with, which sheets allocate their cells from directly
+    /// so that unload_sheet() gives their memory back.
+    std::pmr::monotonic_buffer_resource arena;
+
     /// The number of worksheets present in the workbook file.
     /// This information is available even when no sheets have been loaded.
     size_t nsheets = 0;
@@ -54,6 +116,14 @@ public:
     /// The encoding that was derived from the codepage.
     std::string encoding;
 
+    /// Converter for encoding, resolved once by derive_encoding(); pass
+    /// it rather than encoding to unpack_string().
+    util::codec_t codec;
+
+    /// Encoding to use instead of the one derived from the codepage, for
+    /// files whose CODEPAGE record is missing or wrong (pre-BIFF8 only).
+    std::string encoding_override;
+
     /// A pair containing the telephone country code for:
     /// [0]: the user-interface setting when the file was created.
     /// [1]: the regional settings.
@@ -67,6 +137,10 @@ public:
     /// save to file.
     std::string user_name;
 
+    /// true while user_name still holds the undecoded bytes of a pre-BIFF8
+    /// WRITEACCESS record seen before the CODEPAGE record.
+    bool raw_user_name = false;
+
     /// A vector of excelr8::formatting::Font class instances,
     /// each corresponding to a FONT record.
     std::vector<formatting::Font> font_list;
@@ -110,6 +184,7 @@ public:
     ///
     /// Color indexes into the palette map into {red, green, blue} tuples.
     /// "Magic" indexes e.g. 0x7FFF map to nullptr.
+    /// The tuples live in the Book's arena.
     ///
     /// color_map is what you need if you want to render cells on screen or
     /// in a PDF file. If you are writing an output XLS file, use palette_record.
@@ -128,6 +203,9 @@ public:
     /// Note: Extracted only if open_workbook(..., formatting_info=true)
     std::vector<color_t> palette_record;
 
+    /// The shared string table; LABELSST cells are indexes into it.
+    sst_t shared_strings { &arena };
+
     /// Time in seconds to extract the XLS image as a contiguous string
     /// (or mmap equivalent).
     float load_time_stage_1 = -1.0;
@@ -138,9 +216,127 @@ public:
 
     bool formatting_info = false;
 
+    /// Sheets are parsed when first asked for rather than at open time.
+    bool on_demand = false;
+
+    /// The shared string table is indexed at open time and each string
+    /// decoded on first access (see index_sst_table()).
+    bool lazy_sst = false;
+
+    /// Worker threads get_sheets() parses sheets on, and that a large
+    /// shared string table is decoded on; 0 means
+    /// std::thread::hardware_concurrency(). Sheets only share read-only
+    /// workbook data, so the result is the same as with one thread.
+    unsigned nthreads = 1;
+
+    /// Rows and columns of each sheet to load; see sheet::projection_t.
+    sheet::projection_t projection;
+
+    /// Names of the sheets get_sheets() loads; none means all of them.
+    /// The others can still be loaded with sheet_by_index().
+    std::vector<std::string> sheet_subset;
+
+    /// The Workbook (or Book) stream of the compound document, or the
+    /// whole file for a bare BIFF file. Sheets are parsed from it on
+    /// demand, so it stays open as long as the Book.
+    stream_view_t workbook_stream;
+
+    /// One entry per worksheet, in workbook order. A null entry is a sheet
+    /// that hasn't been loaded yet (on_demand) or has been unloaded.
+    std::vector<std::unique_ptr<sheet::Sheet>> _sheet_list;
+
+    std::vector<std::string> _sheet_names;
+    std::vector<uint8_t> _sheet_visibility;
+
+    /// workbook_stream offset of each worksheet's BOF record, from its
+    /// BOUNDSHEET record.
+    std::vector<uint64_t> _sh_abs_posn;
+
+    /// row_index() results, built on first use
+    mutable std::vector<std::shared_ptr<const sheet::row_index_t>> _row_indexes;
+    mutable std::mutex _row_indexes_mutex;
+
+    /// upstream must outlive the Book, and be thread-safe if sheets are
+    /// parsed on several threads (nthreads).
+    explicit Book(std::pmr::memory_resource* upstream = std::pmr::get_default_resource());
+
     void derive_encoding();
 
+    /// Finds the workbook stream in source (an OLE2 compound document or
+    /// a bare BIFF stream). Throws biff::Excelr8Error if there is none.
+    void biff2_8_load(std::shared_ptr<const byte_source_t> source, bool ignore_workbook_corruption = false);
+
+    /// Reads the BOF record at the cursor and returns the BIFF version.
+    /// Throws biff::Excelr8Error unless it opens a stream of type
+    /// rqd_stream (XL_WORKBOOK_GLOBALS, XL_WORKSHEET, ...).
+    int getbof(biff::record_cursor_t& cursor, int rqd_stream) const;
+
+    /**
+        Reads what can be known about the workbook without decoding any
+        cell, shared string or formatting record: the sheet list,
+        codepage, datemode and each worksheet's DIMENSIONS record. The
+        globals are walked record by record with nothing but BOUNDSHEET,
+        CODEPAGE and DATEMODE decoded, and each worksheet is read only up
+        to its DIMENSIONS record; other records are passed over by their
+        headers. BOUNDSHEET records go through handle_boundsheet(), so the
+        globals' worksheets are entered in the sheet list, but without the
+        shared strings none can be loaded; call it instead of
+        parse_globals(), after biff2_8_load().
+    */
+    workbook_info_t scan_info();
+
+    /// Reads the workbook globals: sheet list, codepage, datemode, shared
+    /// strings and (with formatting_info) fonts, up to the globals' EOF.
+    void parse_globals();
+
+    /// In a BIFF2-4 worksheet file, which has no globals, reads the
+    /// sheet's CODEPAGE and DATEMODE records and derives the encoding
+    /// from them; the cursor is just past the BOF.
+    void read_worksheet_settings(biff::record_cursor_t& cursor);
+
+    /// Adds a worksheet to the sheet list (other sheet types are not
+    /// loaded); returns what the record says, whatever the sheet's type.
+    sheet_info_t handle_boundsheet(data_view_t data);
+    void handle_codepage(data_view_t data);
+    void handle_country(data_view_t data);
+    void handle_datemode(data_view_t data);
+    void handle_writeaccess(data_view_t data);
+    /// The cursor is at the SST record; leaves it after SST/EXTSST.
+    void handle_sst(biff::record_cursor_t& cursor);
+
+    /// Parses every sheet (of sheet_subset, if given) that isn't loaded
+    /// yet, on nthreads workers. Throws biff::Excelr8Error if
+    /// sheet_subset names a sheet that doesn't exist. If
+    /// sheets fail to parse, the error of the first of them (in workbook
+    /// order) is thrown once the others are done, with the sheets before
+    /// it loaded.
+    void get_sheets();
+
+    /// Parses sheet sheetx from workbook_stream without touching the Book;
+    /// safe to call from several threads at once.
+    std::unique_ptr<sheet::Sheet> _parse_sheet(size_t sheetx) const;
+
+    /// Parses sheet sheetx from workbook_stream, replacing any loaded copy.
+    sheet::Sheet& get_sheet(size_t sheetx);
+
+    const std::vector<std::string>& sheet_names() const;
+
+    /// The sheet, parsing it first if it isn't loaded. Not safe to call
+    /// from several threads while sheets are being loaded.
+    sheet::Sheet& sheet_by_index(size_t sheetx);
+    sheet::Sheet& sheet_by_name(const std::string& sheet_name);
+
+    bool sheet_loaded(size_t sheetx) const;
+
+    /// Releases a loaded sheet; a later sheet_by_index() parses it again.
+    /// References to the sheet are invalidated.
+    void unload_sheet(size_t sheetx);
+
+    /// Row block index of sheet sheetx (see sheet::row_index_t), built the
+    /// first time it is asked for and kept for the life of the Book. Safe
+    /// to call from several threads.
+    std::shared_ptr<const sheet::row_index_t> row_index(size_t sheetx) const;
+
     int verbosity = 0;
-    
 };
 }
\ No newline at end of file
@@ -0,0 +1,70 @@
+#pragma once
+
+/*
+    Conversion of workbook text to UTF-8.
+
+    Before BIFF8 every string is in the workbook's codepage (CODEPAGE
+    record), so the same encoding is applied to every string in the file.
+    A codec_t resolves the encoding name once:
+
+    - latin_1 and utf_16_le go to the transcoders in util.hpp;
+    - the common single-byte codepages (cp1250..cp1258, the DOS and Mac
+      codepages, koi8_r) are a 256-entry byte -> UTF-8 table built at
+      compile time;
+    - anything else goes through ICU, with converters kept in a small
+      per-thread pool and reset between strings instead of being opened
+      and closed every time.
+*/
+
+#include "excelr8/data.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace excelr8::util {
+
+/// UTF-8 form of one byte of a single-byte codepage
+struct byte_utf8_t {
+    uint8_t length;
+    char bytes[3];
+};
+
+using codepage_table_t = std::array<byte_utf8_t, 256>;
+
+/// The compile-time table for a single-byte encoding, or nullptr if there
+/// is none. Names are those produced by Book::derive_encoding() ("cp1252",
+/// "mac_roman", ...).
+dllexport const codepage_table_t* find_codepage_table(std::string_view encoding);
+
+class dllexport codec_t {
+public:
+    enum class kind_t : uint8_t { latin1, utf16le, table, icu };
+
+private:
+    std::string _encoding = "latin_1";
+    kind_t _kind = kind_t::latin1;
+    const codepage_table_t* _table = nullptr;
+
+public:
+    /// latin_1
+    codec_t() = default;
+    explicit codec_t(std::string_view encoding);
+
+    const std::string& encoding() const;
+    kind_t kind() const;
+
+    /// Appends the UTF-8 form of data to out. Characters that can't be
+    /// converted become U+FFFD; an encoding that ICU doesn't know at all
+    /// is reported on std::cerr and appends nothing, as unicode() does.
+    void decode(data_view_t data, std::string& out) const;
+    std::string decode(data_view_t data) const;
+};
+
+/// Drops the calling thread's pooled ICU converters. Threads release them
+/// when they exit; this is for long-lived threads that are done with
+/// workbooks.
+dllexport void release_converters();
+
+}
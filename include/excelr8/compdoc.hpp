@@ -7,11 +7,23 @@ from an OLE2 Compound Document file.
 */
 
 #include "excelr8/data.hpp"
+#include "excelr8/mmap.hpp"
+#include "excelr8/source.hpp"
+#include "excelr8/stream.hpp"
+#include <array>
+#include <cstdint>
+#include <filesystem>
 #include <format>
 #include <iostream>
 #include <memory>
+#include <memory_resource>
+#include <optional>
 #include <ostream>
+#include <span>
 #include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 namespace excelr8::compdoc {
@@ -25,27 +37,44 @@ const int SATSID = -3;
 const int MSATSID = -4;
 const int EVILSID = -5;
 
+// How much corruption bookkeeping to do while walking sector chains.
+// strict records the owner of every sector, so overlapping chains are
+// caught and reported like xlrd does. trusted keeps no per-sector state,
+// only the bounds checks and a chain-length limit that stops loops; use it
+// for files from a known-good writer that are read over and over.
+enum class validation_t {
+    strict,
+    trusted,
+};
+
 class dllexport CompDocError : public std::runtime_error {
     using std::runtime_error::runtime_error;
 };
 
-class dllexport DirNode {
-private:
-    std::ostream& logfile;
-    unsigned char color;
-    uint32_t tsinfo[4];
-
-public:
-    std::string name;
-    int32_t first_sid, tot_size;
-    int32_t did, left_did, right_did, root_did;
-    int32_t parent = -1; // -1 indicates orphan, fixed up later
-    std::vector<int32_t> children;
-    unsigned char etype;
+// The directory, one column per field of the 128-byte entries, indexed by
+// DID. Names share a single buffer and the children of each storage are a
+// range of the flat kids array, so the whole table is a handful of
+// allocations however many entries the file has.
+struct dllexport dir_table_t {
+    std::string names;
+    std::vector<uint32_t> name_end; // name(did) = names[name_end[did-1], name_end[did])
+    std::vector<unsigned char> etype, color;
+    std::vector<int32_t> left_did, right_did, root_did;
+    std::vector<int32_t> parent; // -1 indicates orphan, fixed up later
+    std::vector<int32_t> first_sid;
+    std::vector<uint64_t> tot_size;
+    std::vector<std::array<uint32_t, 4>> tsinfo;
+    std::vector<int32_t> kids;
+    std::vector<uint32_t> kids_first, kids_count;
+
+    size_t size() const { return etype.size(); }
+    std::string_view name(int did) const;
+    std::span<const int32_t> children(int did) const;
 
     // dent is the 128-byte directory entry
-    DirNode(int did, const data_t dent, int debug = 0, std::ostream& logfile = std::cout);
-    void dump(int debug = 1);
+    // major_version 4 means 4096-byte sectors and 64-bit stream sizes
+    void append(data_view_t dent, int major_version = 3);
+    void dump(int did, std::ostream& logfile, int debug = 1) const;
 };
 
 class dllexport CompDoc {
@@ -54,29 +83,54 @@ class dllexport CompDoc {
 private:
     std::ostream& logfile;
     bool ignore_workbook_corruption;
+    validation_t validation;
     int debug;
     int sec_size, short_sec_size;
     int32_t dir_first_sec_sid, min_size_std_stream;
-    const data_t& mem;
-    int mem_data_secs, mem_data_len;
-    std::vector<unsigned char> seen;
-    std::vector<int> SAT, SSAT;
-    std::vector<DirNode*> dirlist;
-    data_t* SSCS = nullptr;
-
-    data_t& _get_stream(const data_t& mem, int base, std::vector<int>& sat, int sec_size, int start_sid, int size = -1, std::string name = "", int seen_id = -1);
-    DirNode* _dir_search(const std::vector<std::string>& path, int storage_did = 0);
-    std::tuple<const data_t*, int, int> _locate_stream(const data_t& mem, int base, std::vector<int>& sat, int sec_size, int start_sid, int expected_stream_size, const std::string& qname, int seen_id);
+    std::shared_ptr<const byte_source_t> source;
+    // Sector tables and get_named_stream() buffers; released in one go
+    // with the document
+    std::pmr::monotonic_buffer_resource arena;
+    uint64_t mem_data_secs, mem_data_len;
+    std::pmr::vector<unsigned char> seen; // empty when validation is trusted
+    std::pmr::vector<int> SAT, SSAT;
+    dir_table_t dir;
+    std::unordered_map<std::string, int> dir_index; // case-folded path -> DID
+    int32_t SSAT_first_sec_sid, SSAT_tot_secs;
+    bool sscs_loaded = false;
+    stream_view_t SSCS; // short-sector container stream, see _short_sectors()
+
+    void _advise(access_hint_t hint, uint64_t offset, uint64_t length) const;
+    uint64_t _sector_offset(int sid) const;
+    void _claim_sector(int sid, int seen_id, const std::string& name);
+    void _read_sids(uint64_t offset, int count, std::pmr::vector<int>& sids) const;
+    stream_view_t _get_stream(const stream_view_t& container, uint64_t base, std::pmr::vector<int>& sat, int sec_size, int start_sid, int64_t size = -1, std::string name = "", int seen_id = -1);
+    const stream_view_t& _short_sectors();
+    void _load_short_sectors();
+    void _build_family_tree();
+    void _build_dir_index();
+    int _dir_search(const std::string& qname);
+    stream_view_t _locate_stream(uint64_t base, std::pmr::vector<int>& sat, int sec_size, int start_sid, uint64_t expected_stream_size, const std::string& qname, int seen_id);
 
 public:
-    CompDoc(const data_t& mem, std::ostream& logfile = std::cout, int debug = 0, bool ignore_workbook_corruption = false);
-    data_t* get_named_stream(const std::string& qname);
-    std::tuple<const data_t*, int, int> locate_named_stream(const std::string& qname);
-};
+    // Every constructor takes the upstream for the document's arena; pass
+    // a Book's arena (or any pool) to keep a whole batch on one resource.
+
+    // mem must outlive the CompDoc and every view it hands out
+    CompDoc(data_view_t mem, std::ostream& logfile = std::cout, int debug = 0, bool ignore_workbook_corruption = false, std::pmr::memory_resource* resource = std::pmr::get_default_resource(), validation_t validation = validation_t::strict);
 
-void _build_family_tree(const std::vector<DirNode*>& dirlist, int parent_did, int child_did);
+    // Memory-maps the file read-only and parses it in place
+    CompDoc(const std::filesystem::path& filename, std::ostream& logfile = std::cout, int debug = 0, bool ignore_workbook_corruption = false, std::pmr::memory_resource* resource = std::pmr::get_default_resource(), validation_t validation = validation_t::strict);
+
+    // Any byte source, e.g. a pread_source_t for files that shouldn't be
+    // resident; only the sectors actually needed are read
+    CompDoc(std::shared_ptr<const byte_source_t> source, std::ostream& logfile = std::cout, int debug = 0, bool ignore_workbook_corruption = false, std::pmr::memory_resource* resource = std::pmr::get_default_resource(), validation_t validation = validation_t::strict);
+
+    std::optional<data_view_t> get_named_stream(const std::string& qname);
+    std::optional<stream_view_t> locate_named_stream(const std::string& qname);
+};
 
 template <typename T>
-void dump_list(std::vector<T>& list, int stride, std::ostream& f = std::cout);
+void dump_list(const std::pmr::vector<T>& list, int stride, std::ostream& f = std::cout);
 
 }
\ No newline at end of file
@@ -17,6 +17,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <string>
+#include <tuple>
 #include <vector>
 
 // python struct type aliases
@@ -41,24 +42,77 @@ using pytype_d = double;
 // skipping the rest
 
 namespace excelr8 {
-class dllexport data_t {
+
+class data_t;
+
+/**
+    A non-owning, read-only view over a range of bytes.
+
+    Views are what data_t::slice() hands out, so header fields, directory
+    entries and strings can be decoded in place without copying them.
+    The underlying buffer must outlive every view taken from it.
+    All reads are bounds-checked and throw std::out_of_range.
+*/
+class dllexport data_view_t {
 private:
-    std::vector<std::byte> _data;
+    const std::byte* _ptr = nullptr;
+    size_t _size = 0;
+
+    void _check(size_t offset, size_t count) const;
 
     template <typename T>
     T _unpack(size_t& offset) const;
 
+public:
+    data_view_t() = default;
+    data_view_t(const std::byte* ptr, size_t size);
+    data_view_t(const data_t& data);
+
+    // Python slice semantics: [start, end), clamped to the view
+    data_view_t slice(size_t start, size_t end) const;
+
+    template <typename... Ts>
+    std::tuple<Ts...> unpack(size_t offset = 0) const;
+
+    template <typename T>
+    std::vector<T> unpack_vec(size_t count, size_t offset = 0) const;
+
+    const std::byte* data() const;
+    size_t size() const;
+    bool empty() const;
+    const std::byte* begin() const;
+    const std::byte* end() const;
+    std::byte operator[](size_t index) const;
+    bool operator==(const data_view_t& other) const;
+    bool operator!=(const data_view_t& other) const;
+    std::string to_string() const;
+};
+
+class dllexport data_t {
+private:
+    std::vector<std::byte> _data;
+
 public:
     data_t();
     data_t(std::vector<std::byte>& buffer);
+    data_t(std::vector<std::byte>&& buffer);
     data_t(const std::string& buffer);
-    data_t slice(int start, int end) const;
+    explicit data_t(data_view_t view);
+
+    // Returns a view into this buffer; no bytes are copied
+    data_view_t slice(size_t start, size_t end) const;
 
     template <typename... Ts>
-    std::tuple<Ts...> unpack(size_t offset = 0) const;
+    std::tuple<Ts...> unpack(size_t offset = 0) const
+    {
+        return data_view_t(*this).unpack<Ts...>(offset);
+    }
 
     template <typename T>
-    std::vector<T> unpack_vec(size_t count) const;
+    std::vector<T> unpack_vec(size_t count, size_t offset = 0) const
+    {
+        return data_view_t(*this).unpack_vec<T>(count, offset);
+    }
 
     const std::byte* data() const;
     size_t size() const;
@@ -66,8 +120,8 @@ public:
     std::vector<std::byte>::const_iterator end() const;
     bool operator==(const data_t& other) const;
     bool operator!=(const data_t& other) const;
-    inline data_t& operator+=(const data_t& other);
-    data_t& append(const data_t& other);
+    data_t& operator+=(data_view_t other);
+    data_t& append(data_view_t other);
     std::string to_string() const;
 };
-}
\ No newline at end of file
+}
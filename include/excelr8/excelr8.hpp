@@ -2,3 +2,84 @@
 
 #include "excelr8/util.hpp"
 #include "excelr8/biff.hpp"
+#include "excelr8/book.hpp"
+#include "excelr8/source.hpp"
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+namespace excelr8 {
+
+/// Options for open_workbook()
+struct open_options_t {
+    /// Diagnostics level; 0 is silent.
+    int verbosity = 0;
+
+    /// Read formatting information (fonts so far) as well as cell data.
+    bool formatting_info = false;
+
+    /// Parse only the workbook globals at open time; each sheet is parsed
+    /// when first asked for (Book::sheet_by_index()) and can be released
+    /// again with Book::unload_sheet().
+    bool on_demand = false;
+
+    /// Threads to parse sheets on when they are loaded at open time, and
+    /// to decode a large shared string table on; 0 means one per core.
+    /// The Book is the same whatever the count.
+    unsigned nthreads = 1;
+
+    /// Rows and columns to load from each sheet, e.g.
+    /// projection_t().columns("A, C:F").rows(1, 99999); cells outside them
+    /// are skipped without being decoded.
+    sheet::projection_t projection;
+
+    /// Names of the sheets to load at open time; none means all. Other
+    /// sheets are parsed when asked for, like with on_demand.
+    std::vector<std::string> sheets;
+
+    /// Decode shared strings on first access instead of at open time.
+    bool lazy_sst = false;
+
+    /// Encoding to use instead of the one given by the CODEPAGE record
+    /// (pre-BIFF8 files only), e.g. "cp1251".
+    std::string encoding_override;
+
+    /// Try to read compound documents whose sector chains are damaged.
+    bool ignore_workbook_corruption = false;
+
+    /// Upstream of the Book's arena, which parse-time objects (compound
+    /// document tables, shared strings, ...) are allocated from, and of
+    /// the sheets' cell storage; e.g. a pool shared across a batch. Must
+    /// outlive the Book, and be thread-safe if nthreads isn't 1. Null
+    /// means std::pmr::get_default_resource().
+    std::pmr::memory_resource* memory_resource = nullptr;
+};
+
+/// Opens a spreadsheet file (an OLE2 compound document or a bare BIFF
+/// stream) from disk; the file is memory-mapped.
+dllexport std::unique_ptr<book::Book> open_workbook(const std::filesystem::path& filename, const open_options_t& options = {});
+
+/// Same, from a caller-owned buffer that must outlive the Book.
+dllexport std::unique_ptr<book::Book> open_workbook(data_view_t file_contents, const open_options_t& options = {});
+
+/// Same, from any byte source.
+dllexport std::unique_ptr<book::Book> open_workbook(std::shared_ptr<const byte_source_t> source, const open_options_t& options = {});
+
+/**
+    Reads a workbook's sheet list, sheet types and visibility, DIMENSIONS
+    bounds, codepage, datemode and BIFF version without decoding any cell,
+    shared string or formatting data (see book::Book::scan_info()). Of
+    options, only encoding_override and ignore_workbook_corruption apply.
+*/
+dllexport book::workbook_info_t open_workbook_info(std::shared_ptr<const byte_source_t> source, const open_options_t& options = {});
+
+/// Same, from a file on disk, which is memory-mapped.
+dllexport book::workbook_info_t open_workbook_info(const std::filesystem::path& filename, const open_options_t& options = {});
+
+/// Same, from a caller-owned buffer.
+dllexport book::workbook_info_t open_workbook_info(data_view_t file_contents, const open_options_t& options = {});
+
+}
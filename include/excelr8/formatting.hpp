@@ -203,9 +203,9 @@ public:
     bool shadow = false;
 };
 
-void handle_efont(book::Book& book, const data_t& data); // BIFF2 only
+void handle_efont(book::Book& book, data_view_t data); // BIFF2 only
 
-void handle_font(book::Book& book, const data_t& data);
+void handle_font(book::Book& book, data_view_t data);
 
 /**
     "Number format" information from a FORMAT record.
@@ -298,5 +298,29 @@ const std::vector<std::tuple<int, int, int>> fmt_code_ranges = {
 
 extern std::unordered_map<int, int> std_format_code_types;
 
-class XF;
+/**
+    eXtended Formatting information for cells, rows, columns and styles.
+
+    Only the fields that tie a cell to its font and number format are
+    kept so far; the alignment, border, background and protection groups
+    are not extracted.
+*/
+class XF {
+public:
+    /// true if this is a style XF, false if this is a cell XF
+    bool is_style = false;
+
+    /// Cell XF: index into Book::xf_list of this XF's style XF.
+    /// Style XF: 0xFFF
+    int parent_style_index = 0;
+
+    /// Index into Book::xf_list
+    int xf_index = 0;
+
+    /// Key into Book::font_list
+    int font_index = 0;
+
+    /// Key into Book::format_map
+    int format_key = 0;
+};
 }
\ No newline at end of file
@@ -0,0 +1,46 @@
+#pragma once
+
+/*
+    Read-only memory mapping of a workbook file, so that the OLE2 container
+    and the BIFF streams inside it can be parsed in place instead of being
+    read into one big owning buffer first.
+*/
+
+#include "excelr8/data.hpp"
+#include "excelr8/source.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+namespace excelr8 {
+
+class dllexport mapped_file_t : public byte_source_t {
+private:
+    const std::byte* _ptr = nullptr;
+    size_t _size = 0;
+#if defined _WIN32 || defined __CYGWIN__
+    void* _file = nullptr;
+    void* _mapping = nullptr;
+#endif
+
+    void _unmap();
+
+public:
+    /// Maps the whole file read-only. Throws std::system_error on failure.
+    explicit mapped_file_t(const std::filesystem::path& filename);
+    ~mapped_file_t();
+
+    mapped_file_t(const mapped_file_t&) = delete;
+    mapped_file_t& operator=(const mapped_file_t&) = delete;
+
+    data_view_t view() const;
+    uint64_t size() const override;
+    size_t read(uint64_t offset, size_t count, std::byte* dst) const override;
+    const std::byte* resident() const override;
+
+    /// Tells the kernel how [offset, offset + length) is going to be read.
+    /// This is only a hint; failures are ignored.
+    void advise(access_hint_t hint, uint64_t offset = 0, uint64_t length = UINT64_MAX) const override;
+};
+
+}
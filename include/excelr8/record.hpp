@@ -0,0 +1,94 @@
+#pragma once
+
+/*
+    Cursor over the records of a BIFF stream.
+
+    Every BIFF record is a 4-byte header (opcode, payload length) followed
+    by the payload. The cursor walks a stream_view_t and hands out each
+    payload as a view, without copying when the stream is a single run of
+    a resident source (the common case for an mmap'ed or in-memory file).
+
+    Records longer than 8224 bytes are split by the writer into a head
+    record and CONTINUE records; next_joined() presents them as one
+    payload and remembers where each piece began, since some records (SST,
+    TXO, ...) restart string state at every CONTINUE boundary.
+*/
+
+#include "excelr8/biff.hpp"
+#include "excelr8/data.hpp"
+#include "excelr8/stream.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace excelr8::biff {
+
+struct record_t {
+    uint16_t opcode;
+    /// Payload length as recorded in the header(s); payload may be shorter
+    /// if the stream is truncated.
+    size_t length;
+    data_view_t payload;
+    /// Stream offset of the (first) record header.
+    uint64_t offset;
+};
+
+class dllexport record_cursor_t {
+private:
+    stream_view_t _stream;
+    data_view_t _mem; // the whole stream, when it can be viewed in place
+    bool _in_place = false;
+    uint64_t _pos = 0;
+    std::vector<std::byte> _joined; // backs a payload stitched from CONTINUE records
+    std::vector<size_t> _segments; // offset of each piece within the joined payload
+
+    bool _header(uint64_t pos, uint16_t& opcode, uint16_t& length);
+    data_view_t _payload(uint64_t pos, size_t length);
+    void _append(uint64_t pos, size_t length);
+
+public:
+    explicit record_cursor_t(stream_view_t stream);
+
+    /// A caller-owned buffer, which must outlive the cursor.
+    explicit record_cursor_t(data_view_t mem);
+
+    uint64_t size() const;
+    uint64_t tell() const;
+    void seek(uint64_t pos);
+
+    /// true if fewer than 4 bytes remain, i.e. there is no further record
+    bool eof() const;
+
+    /// Opcode of the next record without advancing, or nullopt at the end.
+    std::optional<uint16_t> peek_opcode();
+
+    /// The next record, or nullopt at the end of the stream.
+    /// The payload points into the source when the stream is resident and
+    /// contiguous; otherwise it is valid only until the next call.
+    std::optional<record_t> next();
+
+    /// Moves past the next record, reading only its header; its opcode, or
+    /// nullopt at the end of the stream.
+    std::optional<uint16_t> skip();
+
+    /// Like next(), but any CONTINUE records that follow are appended to
+    /// the payload. When there are none and the stream is resident the
+    /// payload is still a view in place; otherwise it is valid until the
+    /// next call to next_joined(), so records after it can be read with
+    /// next() while it is in use.
+    std::optional<record_t> next_joined(uint16_t continue_opcode = XL_CONTINUE);
+
+    /// Offsets within the last next_joined() payload at which the head
+    /// record and each CONTINUE record began; always starts with 0.
+    const std::vector<size_t>& segments() const;
+};
+
+/**
+    Reads past an embedded substream (a chart in a worksheet) whose BOF
+    record has just been read, up to and including its EOF. Returns false
+    if the stream ends first.
+*/
+dllexport bool skip_substream(record_cursor_t& cursor);
+
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+/*
+    RK numbers.
+
+    An RK value is a 32-bit packing of a cell number: bit 1 says whether
+    the upper 30 bits are a signed integer or the top 30 bits of an IEEE
+    double (the low 34 bits being zero), and bit 0 says whether the result
+    is to be divided by 100. RK records hold one; MULRK records hold a run
+    of them for consecutive columns of a row, and make up most of the cell
+    records of a numeric sheet.
+
+    unpack_mulrk() decodes a whole MULRK payload into caller-provided
+    column buffers in one pass, several values at a time with SSE2/AVX2.
+*/
+
+#include "excelr8/data.hpp"
+#include "excelr8/util.hpp"
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace excelr8::biff {
+
+/// The number an RK value stands for
+constexpr double rk_to_double(uint32_t rk)
+{
+    double d;
+    if (rk & 2) {
+        // a signed 30-bit integer
+        d = static_cast<double>(static_cast<int32_t>(rk) >> 2);
+    } else {
+        // the most significant 30 bits of a double
+        d = std::bit_cast<double>(static_cast<uint64_t>(rk & 0xFFFFFFFCu) << 32);
+    }
+    return (rk & 1) ? d / 100.0 : d;
+}
+
+static_assert(rk_to_double(0x3FF00000) == 1.0);
+static_assert(rk_to_double(0x3FF00001) == 0.01);
+static_assert(rk_to_double((static_cast<uint32_t>(-5) << 2) | 2) == -5.0);
+static_assert(rk_to_double((12345u << 2) | 3) == 123.45);
+
+/// An RK record
+struct rk_cell_t {
+    uint16_t row;
+    uint16_t col;
+    uint16_t xf_index;
+    double value;
+};
+
+/// Decodes an RK record; throws Excelr8Error if it is short.
+dllexport rk_cell_t unpack_rk(data_view_t payload);
+
+struct mulrk_t {
+    uint16_t row;
+    uint16_t first_col;
+    uint16_t last_col;
+    /// Number of cells, last_col - first_col + 1
+    size_t count;
+};
+
+/// Row and columns of a MULRK record without decoding the values; throws
+/// Excelr8Error if the payload length and the column range disagree.
+dllexport mulrk_t mulrk_header(data_view_t payload);
+
+/**
+    Decodes a MULRK record.
+
+    :param values:
+        Receives the cells' numbers; must have room for
+        mulrk_header(payload).count entries.
+    :param xf_indexes:
+        Receives the cells' XF indexes, likewise.
+*/
+dllexport mulrk_t unpack_mulrk(data_view_t payload, double* values, uint16_t* xf_indexes);
+
+/// Same, appending to the vectors.
+dllexport mulrk_t unpack_mulrk(data_view_t payload, std::vector<double>& values, std::vector<uint16_t>& xf_indexes);
+
+/**
+    Decodes the cells of a MULRK record that lie in columns
+    first_colx..last_colx, replacing the contents of the vectors. The
+    result has first_col, last_col and count narrowed to the cells
+    decoded; count is 0 if none are in range.
+*/
+dllexport mulrk_t unpack_mulrk_columns(data_view_t payload, uint16_t first_colx, uint16_t last_colx, std::vector<double>& values, std::vector<uint16_t>& xf_indexes);
+
+/**
+    Decodes count RK values laid out stride bytes apart, each preceded by
+    its 2-byte XF index (stride 6 for MULRK). The building block of
+    unpack_mulrk(), for callers that have located the values themselves.
+*/
+dllexport void unpack_rk_run(const std::byte* src, size_t count, size_t stride, double* values, uint16_t* xf_indexes);
+
+/// Same, on a chosen code path (see util::simd_level()), so the paths can
+/// be checked against each other.
+dllexport void unpack_rk_run(const std::byte* src, size_t count, size_t stride, double* values, uint16_t* xf_indexes, util::simd_t level);
+
+}
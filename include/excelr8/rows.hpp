@@ -0,0 +1,141 @@
+#pragma once
+
+/*
+    Streaming access to a worksheet, a row at a time.
+
+    A row_reader_t walks the sheet's records itself instead of loading the
+    sheet into a Sheet: each next() decodes the cell records of one row
+    into a buffer that is reused for the following row. Memory use depends
+    on the widest row, not on the number of rows, so sheets of millions of
+    rows can be converted without ever being held in memory.
+
+    Rows come in the order their cells are stored, which for files written
+    by Excel is ascending row order. Rows without cells (ROW records only
+    carry height and formatting) are not reported.
+
+    Cells are stored in blocks of up to 32 rows. A row_index_t records
+    where each block starts, taken from the sheet's INDEX and DBCELL
+    records or, when a writer left them out, from a single scan of the
+    sheet; row_reader_t::seek() uses it to start reading at any row after
+    reading at most one block's worth of records.
+*/
+
+#include "excelr8/biff.hpp"
+#include "excelr8/record.hpp"
+#include "excelr8/sheet.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace excelr8::sheet {
+
+/// One cell of the row a row_reader_t is on
+struct row_cell_t {
+    uint16_t colx = 0;
+    uint8_t type = biff::XL_CELL_EMPTY;
+    uint16_t xf_index = 0;
+    /// As in a column_t, except for text cells, which have their text
+    /// in text and 0 here.
+    double value = 0.0;
+    /// Text of an XL_CELL_TEXT cell; valid until the next call to next().
+    std::string_view text;
+};
+
+/// Where each block of rows of a sheet starts in the workbook stream
+class dllexport row_index_t {
+public:
+    struct block_t {
+        /// Lowest row of the block
+        uint32_t first_row;
+        /// workbook_stream offset of the block's first record
+        uint64_t pos;
+    };
+
+    /// In ascending row order
+    std::vector<block_t> blocks;
+
+    /// True if the blocks came from INDEX and DBCELL records rather than
+    /// from a scan of the sheet's records.
+    bool from_index_records = false;
+
+    /**
+        Builds the index of sheet sheetx from its INDEX record and the
+        DBCELL records that points at (BIFF5 and later), or, if there are
+        none or they don't agree with the stream, by scanning its records.
+        Throws std::out_of_range if there is no such sheet.
+    */
+    static row_index_t build(const book::Book& book, size_t sheetx);
+
+    /// Offset to read from to reach row rowx: the start of the last block
+    /// that begins at or before it (or of the first block). nullopt if the
+    /// sheet has no cells.
+    std::optional<uint64_t> find(uint32_t rowx) const;
+};
+
+class dllexport row_reader_t {
+private:
+    const book::Book* _book;
+    size_t _sheetx;
+    biff::record_cursor_t _cursor;
+    cell_decoder_t _decoder;
+    bool _done = false;
+    // rows before this one are skipped (see seek())
+    uint32_t _min_row = 0;
+
+    uint32_t _rowx = 0;
+    std::vector<row_cell_t> _cells;
+    // Text of the row's LABEL, RSTRING and formula string cells; the
+    // strings keep their capacity from row to row.
+    std::vector<std::string> _strings;
+    size_t _nstrings = 0;
+
+    // The sink _decoder hands the current row's cells to
+    friend class cell_decoder_t;
+    void put_cell(uint32_t rowx, uint32_t colx, uint8_t type, uint16_t xf_index, double value);
+    void put_text(uint32_t rowx, uint32_t colx, uint16_t xf_index, std::string text);
+    void put_numbers(uint32_t rowx, uint32_t first_colx, std::span<const double> values, std::span<const uint16_t> xf_indexes);
+    void _finish_row();
+
+public:
+    /// Bounds from the sheet's DIMENSIONS record, once it has been read
+    /// (it precedes the cells); 0 if there is none.
+    uint32_t dimnrows = 0;
+    uint32_t dimncols = 0;
+
+    /**
+        Positions a reader at the start of a sheet.
+
+        :param book:
+            A Book whose globals have been parsed (with on_demand, to keep
+            it from loading the sheets itself); must outlive the reader.
+        :param sheetx:
+            Index of the sheet. Throws std::out_of_range if there is no
+            such sheet.
+        :param projection:
+            Cells to report; the others are skipped without being decoded.
+    */
+    row_reader_t(const book::Book& book, size_t sheetx, projection_t projection = {});
+
+    /// Moves to the next row that has cells; false at the end of the sheet.
+    bool next();
+
+    /**
+        Goes to row rowx: the following next() reports the first row at or
+        after it, going back as well as forward. Uses the Book's
+        row_index() for the sheet, which is built on first use, so only
+        the records of rowx's block are read before it.
+    */
+    void seek(uint32_t rowx);
+
+    /// Index of the current row
+    uint32_t rowx() const;
+
+    /// Cells of the current row, in column order; valid until next().
+    std::span<const row_cell_t> cells() const;
+};
+
+}
@@ -0,0 +1,318 @@
+#pragma once
+
+/*
+    Worksheet cells, stored column by column.
+
+    A column keeps one entry per stored cell in three parallel arrays: the
+    cell type (XL_CELL_*, one byte), the XF index and an 8-byte value. The
+    rows the entries belong to are kept as runs of consecutive rows, so a
+    dense column costs a single run and a sparse one an offset per cell.
+    There are no per-cell objects; a scan over a column is a walk over
+    contiguous arrays.
+
+    The value of a cell is its number (XL_CELL_NUMBER, XL_CELL_DATE), 0 or
+    1 (XL_CELL_BOOLEAN), the error code (XL_CELL_ERROR), or the index of its
+    string (XL_CELL_TEXT), which is in the workbook's shared string table
+    or, for LABEL/RSTRING records, in the sheet's own string list.
+*/
+
+#include "excelr8/biff.hpp"
+#include "excelr8/data.hpp"
+#include "excelr8/record.hpp"
+#include "excelr8/sst.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Forward declaration
+namespace excelr8::book {
+class Book;
+}
+
+namespace excelr8::sheet {
+
+/// One cell, as handed out by Sheet::cell()
+struct cell_t {
+    uint8_t type = biff::XL_CELL_EMPTY;
+    uint16_t xf_index = 0;
+    double value = 0.0;
+};
+
+/**
+    The part of each sheet to load. Cell records outside it are skipped as
+    soon as their row and column are read, before any text is decoded or
+    number converted. Loaded cells keep their row and column indexes, so
+    nrows and ncols count up to the last loaded cell.
+*/
+struct dllexport projection_t {
+    /// Column ranges to keep, first and last inclusive, sorted and
+    /// disjoint; none keeps every column.
+    std::vector<std::pair<uint16_t, uint16_t>> column_ranges;
+
+    /// Rows to keep, inclusive.
+    uint32_t first_row = 0;
+    uint32_t last_row = UINT32_MAX;
+
+    /**
+        Adds columns to keep.
+
+        :param spec:
+            Comma-separated column names and ranges, e.g. "A, C:F".
+            Throws std::invalid_argument if it doesn't parse.
+    */
+    projection_t& columns(std::string_view spec);
+    projection_t& columns(uint16_t first_colx, uint16_t last_colx);
+
+    /// Keeps rows first_rowx..last_rowx (0-based, inclusive) only.
+    projection_t& rows(uint32_t first_rowx, uint32_t last_rowx);
+
+    /// True if nothing is left out.
+    bool all() const;
+
+    bool keeps_row(uint32_t rowx) const { return rowx >= first_row and rowx <= last_row; }
+    bool keeps_column(uint32_t colx) const;
+
+    /// keeps_column() for every column index up to the last kept one.
+    std::vector<bool> column_mask() const;
+};
+
+class dllexport column_t {
+public:
+    /// A run of cells in consecutive rows: rows first_row.. hold the
+    /// entries first_cell.. up to the next run's first_cell.
+    struct run_t {
+        uint32_t first_row;
+        uint32_t first_cell;
+    };
+
+    /// Set in a type byte for text held in the sheet's own string list
+    static constexpr uint8_t local_text = 0x80;
+
+private:
+    std::pmr::vector<uint8_t> _types;
+    std::pmr::vector<uint16_t> _xf_indexes;
+    std::pmr::vector<double> _values;
+    std::pmr::vector<run_t> _runs;
+
+    size_t _run_end(size_t r) const;
+    size_t _run_of_cell(size_t cell) const;
+    size_t _insert(uint32_t row);
+
+public:
+    /// The arrays are allocated from the allocator's resource; a
+    /// std::pmr::vector of columns hands its own down.
+    using allocator_type = std::pmr::polymorphic_allocator<>;
+
+    column_t() = default;
+    explicit column_t(const allocator_type& alloc);
+    column_t(const column_t& other, const allocator_type& alloc);
+    column_t(column_t&& other, const allocator_type& alloc);
+    column_t(const column_t&) = default;
+    column_t(column_t&&) = default;
+    column_t& operator=(const column_t&) = default;
+    column_t& operator=(column_t&&) = default;
+
+    /// Number of stored cells
+    size_t size() const;
+    bool empty() const;
+
+    /// Entry of the cell in row, if it is stored
+    std::optional<size_t> find(uint32_t row) const;
+    uint32_t row_of(size_t cell) const;
+
+    /// Type of an entry, XL_CELL_*
+    uint8_t type(size_t cell) const;
+    bool is_local_text(size_t cell) const;
+
+    std::span<const uint8_t> types() const;
+    std::span<const uint16_t> xf_indexes() const;
+    std::span<const double> values() const;
+    std::span<const run_t> runs() const;
+
+    /// Stores a cell, replacing any already in row. Cells arriving in
+    /// ascending row order (as they do in a BIFF stream) are appended.
+    void set(uint32_t row, uint8_t type, uint16_t xf_index, double value);
+
+    void shrink_to_fit();
+    size_t memory_usage() const;
+};
+
+/**
+    Contents of a "worksheet"
+
+    Warning:
+        You don't instantiate this class yourself. You access Sheet objects
+        via the Book object that was returned when you called
+        excelr8::open_workbook().
+*/
+class dllexport Sheet {
+public:
+    /// Name of sheet.
+    std::string name;
+
+    /// Index of the sheet in the workbook's sheet list.
+    int number = 0;
+
+    /// Number of rows in sheet. A row index is in range(thesheet.nrows).
+    uint32_t nrows = 0;
+
+    /// Nominal number of columns in sheet. It is one more than the maximum
+    /// column index found, ignoring trailing empty cells.
+    uint32_t ncols = 0;
+
+    /// Bounds from the DIMENSIONS record: one past the last row and column
+    /// the writer says are in use. Not necessarily equal to nrows/ncols.
+    uint32_t dimnrows = 0;
+    uint32_t dimncols = 0;
+
+    /// Visibility of the sheet:
+    /// 0: visible; 1: hidden (can be unhidden by user -- Format -> Sheet -> Unhide);
+    /// 2: "very hidden" (can be unhidden only by VBA macro).
+    uint8_t visibility = 0;
+
+    /// The workbook's shared string table, for XL_CELL_TEXT cells that
+    /// came from LABELSST records.
+    const book::sst_t* shared_strings = nullptr;
+
+    /// Text of LABEL and RSTRING cells.
+    std::pmr::vector<std::pmr::string> strings;
+
+    /// One entry per column index up to ncols; a column may be empty.
+    std::pmr::vector<column_t> columns;
+
+private:
+    // MULRK decoding buffers, reused from record to record
+    std::vector<double> _rk_values;
+    std::vector<uint16_t> _rk_xf_indexes;
+
+    void _extend(uint32_t rowx, uint32_t colx);
+
+public:
+    /// Cell storage is allocated from resource, which must outlive the
+    /// sheet.
+    explicit Sheet(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    column_t& column(uint32_t colx);
+
+    /// The cell at (rowx, colx); XL_CELL_EMPTY if there is none.
+    cell_t cell(uint32_t rowx, uint32_t colx) const;
+    uint8_t cell_type(uint32_t rowx, uint32_t colx) const;
+
+    /// Text of an XL_CELL_TEXT cell; an empty view for any other cell.
+    std::string_view cell_text(uint32_t rowx, uint32_t colx) const;
+
+    /// Text of a column's entry; an empty view if it isn't text.
+    std::string_view text(const column_t& column, size_t cell) const;
+
+    /// A cell of any type but local text; see column_t for the value.
+    void put_cell(uint32_t rowx, uint32_t colx, uint8_t type, uint16_t xf_index, double value);
+    void put_number(uint32_t rowx, uint32_t colx, uint16_t xf_index, double value);
+    void put_boolean(uint32_t rowx, uint32_t colx, uint16_t xf_index, bool value);
+    void put_error(uint32_t rowx, uint32_t colx, uint16_t xf_index, uint8_t code);
+    void put_blank(uint32_t rowx, uint32_t colx, uint16_t xf_index);
+    /// Text held in the shared string table
+    void put_sst_text(uint32_t rowx, uint32_t colx, uint16_t xf_index, uint32_t sst_index);
+    /// Text held by the sheet
+    void put_text(uint32_t rowx, uint32_t colx, uint16_t xf_index, std::string text);
+
+    /// Numbers for consecutive columns of a row, from first_colx on
+    void put_numbers(uint32_t rowx, uint32_t first_colx, std::span<const double> values, std::span<const uint16_t> xf_indexes);
+
+    /// Decodes a MULRK record in one batch and spreads the cells over
+    /// their columns. Only cells in columns first_colx..last_colx are
+    /// decoded.
+    void put_mulrk(data_view_t payload, uint16_t first_colx = 0, uint16_t last_colx = UINT16_MAX);
+
+    /**
+        Reads the sheet's records up to its EOF.
+
+        :param cursor:
+            Positioned just past the sheet's BOF record. Records of
+            embedded substreams (charts) are skipped.
+        :param projection:
+            Cells to load; the others are skipped unread.
+    */
+    void read(const book::Book& book, biff::record_cursor_t& cursor, const projection_t& projection = {});
+
+    /// Releases slack capacity once the sheet is loaded.
+    void shrink_to_fit();
+
+    /// Bytes held by the cell storage (not counting shared strings).
+    size_t memory_usage() const;
+};
+
+/**
+    Decodes the cell records of a worksheet for Sheet::read() and
+    row_reader_t, which only store what it hands them.
+
+    Cells the projection leaves out are skipped as soon as their row and
+    column are read. The kept ones go to a sink with
+
+        put_cell(rowx, colx, type, xf_index, value)
+            any type but local text, the value as in a column_t;
+        put_text(rowx, colx, xf_index, std::string text)
+            text of LABEL, RSTRING and formula string cells;
+        put_numbers(rowx, first_colx, values, xf_indexes)
+            the numbers of a MULRK record, for consecutive columns.
+
+    A formula whose result is a string is held back until the STRING
+    record that follows it.
+*/
+class dllexport cell_decoder_t {
+private:
+    // what the decoder keeps of a cell record: its row and columns
+    struct extent_t {
+        uint32_t rowx;
+        uint16_t first_colx;
+        uint16_t last_colx;
+    };
+
+    int _bv;
+    bool _formatting_info;
+    const util::codec_t* _codec;
+    projection_t _projection;
+    std::vector<bool> _column_mask;
+
+    // cell waiting for the STRING record that holds its formula's result
+    bool _string_pending = false;
+    uint32_t _string_rowx = 0;
+    uint16_t _string_colx = 0;
+    uint16_t _string_xf_index = 0;
+
+    // MULRK decoding buffers, reused from record to record
+    std::vector<double> _rk_values;
+    std::vector<uint16_t> _rk_xf_indexes;
+
+    std::optional<extent_t> _extent(uint16_t opcode, data_view_t payload) const;
+    bool _keeps(uint32_t rowx, uint32_t colx) const;
+    bool _keeps_any(const extent_t& extent) const;
+
+public:
+    /// book must outlive the decoder.
+    explicit cell_decoder_t(const book::Book& book, projection_t projection = {});
+
+    /// Row of a cell record that holds a cell the projection keeps (a
+    /// STRING record counts if its formula was kept); nullopt for other
+    /// records.
+    std::optional<uint32_t> row_of(uint16_t opcode, data_view_t payload) const;
+
+    /**
+        Hands the kept cells of a record to sink. Returns false if it is
+        not a cell record (or a cell record that isn't read, e.g. BLANK
+        without formatting_info), so the caller can deal with it.
+        Instantiated for Sheet and row_reader_t.
+    */
+    template <typename Sink>
+    bool decode(uint16_t opcode, data_view_t payload, Sink& sink);
+
+    /// Forgets a formula still waiting for its STRING record.
+    void reset();
+};
+
+}
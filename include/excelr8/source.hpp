@@ -0,0 +1,102 @@
+#pragma once
+
+/*
+    Random-access byte sources that a compound document can be read from.
+
+    CompDoc only ever asks for the header, the MSAT/SAT/SSAT sectors, the
+    directory and the streams it is asked for, so the file doesn't have to
+    be resident: the in-memory and mmap backends hand out bytes in place,
+    the pread backend reads on demand through a bounded sector cache.
+*/
+
+#include "excelr8/data.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace excelr8 {
+
+/// Access pattern hint for a range of a source; see madvise(2).
+enum class access_hint_t {
+    normal,
+    sequential, // stream payloads read front to back
+    random, // header, MSAT, SAT and directory sectors
+    willneed, // start paging in now
+};
+
+class dllexport byte_source_t {
+public:
+    virtual ~byte_source_t() = default;
+
+    /// Offsets and sizes are 64-bit throughout, so files past 2 GB (and
+    /// past 4 GB on 32-bit hosts) work with the pread backend.
+    virtual uint64_t size() const = 0;
+
+    /// Copies up to count bytes at offset into dst; returns the number
+    /// copied, which is short only at the end of the source.
+    virtual size_t read(uint64_t offset, size_t count, std::byte* dst) const = 0;
+
+    /// The whole source if it is addressable in memory, otherwise nullptr.
+    /// Readers use this to hand out views instead of copies.
+    virtual const std::byte* resident() const { return nullptr; }
+
+    /// Tells the source how [offset, offset + length) is going to be read.
+    virtual void advise(access_hint_t, uint64_t, uint64_t) const { }
+};
+
+/// A caller-owned buffer; it must outlive the source.
+class dllexport memory_source_t : public byte_source_t {
+private:
+    data_view_t _data;
+
+public:
+    explicit memory_source_t(data_view_t data);
+
+    uint64_t size() const override;
+    size_t read(uint64_t offset, size_t count, std::byte* dst) const override;
+    const std::byte* resident() const override;
+};
+
+/// Reads the file with pread(2) through an LRU cache of fixed-size blocks,
+/// so memory use stays bounded no matter how large the file is.
+class dllexport pread_source_t : public byte_source_t {
+private:
+    struct block_t {
+        uint64_t index;
+        std::vector<std::byte> bytes;
+    };
+
+#if defined _WIN32 || defined __CYGWIN__
+    void* _file = nullptr;
+#else
+    int _fd = -1;
+#endif
+    uint64_t _size = 0;
+    size_t _block_size;
+    size_t _capacity;
+
+    // most recently used at the front
+    mutable std::list<block_t> _lru;
+    mutable std::unordered_map<uint64_t, std::list<block_t>::iterator> _cache;
+    mutable std::mutex _mutex;
+
+    size_t _pread(uint64_t offset, size_t count, std::byte* dst) const;
+    const block_t& _block(uint64_t index) const;
+
+public:
+    /// block_size is typically the sector size; capacity is in blocks.
+    explicit pread_source_t(const std::filesystem::path& filename, size_t block_size = 4096, size_t capacity = 256);
+    ~pread_source_t();
+
+    pread_source_t(const pread_source_t&) = delete;
+    pread_source_t& operator=(const pread_source_t&) = delete;
+
+    uint64_t size() const override;
+    size_t read(uint64_t offset, size_t count, std::byte* dst) const override;
+};
+
+}
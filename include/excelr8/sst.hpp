@@ -0,0 +1,115 @@
+#pragma once
+
+/*
+    The shared string table (SST record) of a BIFF8 workbook.
+
+    LABELSST cells refer to strings by index into the table. All strings are
+    kept as UTF-8 in a single arena with an offset table beside it, so a
+    table of millions of strings is two allocations and a lookup hands out
+    a string_view.
+
+    Alternatively index_sst_table() only records where each string starts
+    and transcodes it the first time it is asked for, for jobs that touch
+    few of the strings.
+*/
+
+#include "excelr8/data.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace excelr8::book {
+
+class sst_t;
+
+/**
+    Decodes an SST record.
+
+    :param payload:
+        The SST record joined with its CONTINUE records, as returned by
+        record_cursor_t::next_joined().
+    :param segments:
+        Offsets of the pieces within payload (record_cursor_t::segments()).
+        A string whose characters run into a CONTINUE record restarts there
+        with a fresh option byte, which may switch between compressed and
+        uncompressed characters.
+    :param extsst:
+        Payload of the EXTSST record that follows the SST, if any. Its
+        bucket offsets let the table be split between nthreads workers;
+        when it is missing or doesn't agree with the SST, decoding is
+        sequential.
+    :param sst_offset:
+        Stream offset of the SST record header, which EXTSST offsets are
+        relative to (record_t::offset).
+    :param nthreads:
+        Worker count; 0 means std::thread::hardware_concurrency(). Tables
+        of less than sst_parallel_min_size bytes are always decoded on the
+        calling thread, as is everything when no thread can be started.
+    :param resource:
+        Where the table's arena and offsets are allocated; must outlive
+        the table.
+*/
+dllexport sst_t unpack_sst_table(data_view_t payload, const std::vector<size_t>& segments,
+    data_view_t extsst = {}, uint64_t sst_offset = 0, unsigned nthreads = 1,
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+/// Smallest SST payload unpack_sst_table() splits between threads;
+/// below it, starting them costs more than they save.
+inline constexpr size_t sst_parallel_min_size = 256 * 1024;
+
+/**
+    Indexes an SST record without decoding it: a copy of the payload is
+    kept with the position, length and flags of every string, and each
+    string is transcoded on first access and memoized. Same parameters as
+    unpack_sst_table().
+*/
+dllexport sst_t index_sst_table(data_view_t payload, const std::vector<size_t>& segments,
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+class dllexport sst_t {
+private:
+    std::pmr::string _arena; // every string, back to back
+    std::pmr::vector<uint64_t> _offsets = { 0 }; // string i is [_offsets[i], _offsets[i + 1])
+
+    struct lazy_t;
+    std::unique_ptr<lazy_t> _lazy; // set by index_sst_table()
+
+    std::string_view _decode(size_t index) const;
+
+    friend sst_t unpack_sst_table(data_view_t payload, const std::vector<size_t>& segments,
+        data_view_t extsst, uint64_t sst_offset, unsigned nthreads, std::pmr::memory_resource* resource);
+    friend sst_t index_sst_table(data_view_t payload, const std::vector<size_t>& segments,
+        std::pmr::memory_resource* resource);
+
+public:
+    sst_t();
+    /// An empty table whose storage will come from resource; moving a
+    /// table built on the same resource into it takes no copy.
+    explicit sst_t(std::pmr::memory_resource* resource);
+    sst_t(sst_t&&) noexcept;
+    sst_t& operator=(sst_t&&) noexcept;
+    ~sst_t();
+
+    size_t size() const;
+    bool empty() const;
+
+    /// true if strings are decoded on first access
+    bool lazy() const;
+
+    /// Bytes of UTF-8 held: the arena, or what has been decoded so far
+    size_t arena_size() const;
+
+    /// Safe to call from several threads at once, also when lazy(); a lazily
+    /// decoded view stays valid as long as the table. Only the first
+    /// lookup of a lazy string takes a lock.
+    std::string_view operator[](size_t index) const;
+
+    /// Like operator[], but throws std::out_of_range for a bad index
+    std::string_view at(size_t index) const;
+};
+
+}
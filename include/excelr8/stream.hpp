@@ -0,0 +1,101 @@
+#pragma once
+
+/*
+    Scatter-gather view of a stream stored in an OLE2 compound document.
+
+    A stream is a chain of sectors that may be scattered all over the file.
+    Rather than concatenating the fragments into a fresh buffer, stream_view_t
+    keeps the list of (offset, length) extents into the byte source and
+    reads across them with a cursor. When the source is resident in memory
+    the cursor hands out views in place; otherwise it reads on demand.
+*/
+
+#include "excelr8/data.hpp"
+#include "excelr8/source.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+namespace excelr8 {
+
+/// A run of contiguous bytes in the underlying source.
+struct extent_t {
+    uint64_t offset;
+    uint64_t length;
+
+    bool operator==(const extent_t& other) const = default;
+};
+
+class dllexport stream_view_t {
+private:
+    std::shared_ptr<const byte_source_t> _source;
+    const std::byte* _resident = nullptr;
+    std::vector<extent_t> _extents;
+    std::vector<uint64_t> _starts; // logical offset of each extent
+    uint64_t _size = 0;
+
+    // cursor
+    uint64_t _pos = 0;
+    size_t _ext = 0; // index of the extent holding _pos
+    std::vector<std::byte> _scratch; // backs peek() across extents or off a non-resident source
+
+    size_t _find_extent(uint64_t pos) const;
+
+public:
+    stream_view_t() = default;
+
+    /// Adjacent extents are merged; extents are clamped to the source.
+    stream_view_t(std::shared_ptr<const byte_source_t> source, const std::vector<extent_t>& extents);
+
+    /// The whole source as a single-extent stream.
+    explicit stream_view_t(std::shared_ptr<const byte_source_t> source);
+
+    /// The whole of a caller-owned buffer, which must outlive the view.
+    explicit stream_view_t(data_view_t base);
+
+    uint64_t size() const;
+    bool empty() const;
+    const std::vector<extent_t>& extents() const;
+    const std::shared_ptr<const byte_source_t>& source() const;
+
+    /// true if the stream occupies a single run of the underlying source
+    bool contiguous() const;
+
+    /// The whole stream as one view; only valid if contiguous() and the
+    /// source is resident.
+    data_view_t contiguous_view() const;
+
+    /// Copies the stream into an owning buffer.
+    data_t materialize() const;
+
+    /// Maps [offset, offset + length) ranges of this stream onto the
+    /// underlying source, e.g. short sectors inside the SSCS.
+    stream_view_t substream(const std::vector<extent_t>& logical_extents) const;
+
+    uint64_t tell() const;
+    uint64_t remaining() const;
+    bool eof() const;
+    void seek(uint64_t pos);
+    void skip(uint64_t count);
+
+    /// Copies up to count bytes at the cursor into dst; returns the number copied.
+    size_t read(std::byte* dst, size_t count);
+
+    /// View of the next count bytes without advancing. Points straight into
+    /// a resident source unless the range straddles two extents; otherwise
+    /// it is valid only until the next call on this stream.
+    data_view_t peek(size_t count);
+
+    /// peek() and advance past the bytes.
+    data_view_t next(size_t count);
+
+    template <typename... Ts>
+    std::tuple<Ts...> unpack()
+    {
+        return next((sizeof(Ts) + ...)).template unpack<Ts...>();
+    }
+};
+
+}
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "excelr8/data.hpp"
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -16,6 +18,42 @@ namespace excelr8::util {
     template <typename... Ts>
     dllexport std::tuple<Ts...> unpack(const data_t& buffer);*/
 
-    dllexport std::string unicode(const data_t&, const std::string& encoding);
+    dllexport std::string unicode(data_view_t data, const std::string& encoding);
+
+    // Transcoders for the two encodings of BIFF8 text, vectorized with
+    // SSE2/AVX2 where available. They write UTF-8 to dst, which must have
+    // room for the *_utf8_capacity() of the input, and return the number of
+    // bytes written. Unpaired surrogates become U+FFFD. With a carry, a
+    // high surrogate ending src is held back in *carry to be paired with
+    // the first unit of the next call, for strings split across records;
+    // the caller flushes it at the end.
+    constexpr size_t latin1_utf8_capacity(size_t nbytes) { return 2 * nbytes; }
+    constexpr size_t utf16le_utf8_capacity(size_t nunits) { return 3 * nunits + 3; }
+    dllexport size_t latin1_to_utf8(data_view_t src, char* dst);
+    dllexport size_t utf16le_to_utf8(data_view_t src, char* dst, char16_t* carry = nullptr);
+
+    // Same, appending to out
+    dllexport void latin1_to_utf8(data_view_t src, std::string& out);
+    dllexport void utf16le_to_utf8(data_view_t src, std::string& out, char16_t* carry = nullptr);
+
+    // true if the vectorized code paths may use AVX2 on this CPU; checked
+    // once per process
+    dllexport bool cpu_has_avx2();
+
+    // Code paths of the vectorized routines, slowest first
+    enum class simd_t : uint8_t {
+        scalar,
+        sse2,
+        avx2,
+    };
+
+    // The best path this build and CPU support; the one the routines
+    // above take
+    dllexport simd_t simd_level();
+
+    // The transcoders on a chosen path, so the paths can be checked
+    // against each other; a level above simd_level() is lowered to it
+    dllexport size_t latin1_to_utf8(data_view_t src, char* dst, simd_t level);
+    dllexport size_t utf16le_to_utf8(data_view_t src, char* dst, char16_t* carry, simd_t level);
 
 }
\ No newline at end of file
@@ -1,4 +1,6 @@
 #include "excelr8/biff.hpp"
+#include "excelr8/codec.hpp"
+#include "excelr8/record.hpp"
 #include "excelr8/util.hpp"
 #include <algorithm>
 #include <cstdio>
@@ -13,21 +15,21 @@ using namespace excelr8::util;
 
 namespace excelr8::biff {
 
-int calc_nchars(const data_t& data, int pos, int lenlen)
+int calc_nchars(data_view_t data, int pos, int lenlen)
 {
     // nchars:int = unpack('<' + 'BH'[lenlen-1], data[pos:pos+lenlen])[0]
     if (lenlen == 1) {
         // 'B' == unsigned char
-        return std::get<0>(data.slice(pos, pos + lenlen).unpack<pytype_B>());
+        return std::get<0>(data.unpack<pytype_B>(pos));
     } else { // lenlen = 2
         // 'H' == unsigned short
-        return std::get<0>(data.slice(pos, pos + lenlen).unpack<pytype_H>());
+        return std::get<0>(data.unpack<pytype_H>(pos));
     }
 }
 
 bool is_cell_opcode(int c)
 {
-    return _cell_opcode_set.count(c) == 1;
+    return record_info(c).cls == record_class_t::cell;
 }
 
 void upkbits(void* tgt_obj, int src, std::vector<Manifest>& manifests)
@@ -46,15 +48,20 @@ void upkbitsL(void* tgt_obj, int src, std::vector<Manifest>& manifests)
     upkbits(tgt_obj, src, manifests); // but make sure the result is integer
 }
 
-std::string unpack_string(const data_t& data, int pos, const std::string& encoding, int lenlen = 1)
+std::string unpack_string(data_view_t data, int pos, const util::codec_t& codec, int lenlen = 1)
 {
     int nchars = calc_nchars(data, pos, lenlen);
     pos += lenlen;
     auto slice = data.slice(pos, pos + nchars);
-    return unicode(slice, encoding);
+    return codec.decode(slice);
 }
 
-std::pair<std::string, int> unpack_string_update_pos(const data_t& data, int pos, const std::string& encoding, int lenlen = 1, int known_len = -1)
+std::string unpack_string(data_view_t data, int pos, const std::string& encoding, int lenlen = 1)
+{
+    return unpack_string(data, pos, util::codec_t(encoding), lenlen);
+}
+
+std::pair<std::string, int> unpack_string_update_pos(data_view_t data, int pos, const util::codec_t& codec, int lenlen = 1, int known_len = -1)
 {
     int nchars;
     if (known_len != -1) {
@@ -66,10 +73,15 @@ std::pair<std::string, int> unpack_string_update_pos(const data_t& data, int pos
 
     int newpos = pos + nchars;
     auto slice = data.slice(pos, newpos);
-    return { unicode(slice, encoding), newpos };
+    return { codec.decode(slice), newpos };
+}
+
+std::pair<std::string, int> unpack_string_update_pos(data_view_t data, int pos, const std::string& encoding, int lenlen = 1, int known_len = -1)
+{
+    return unpack_string_update_pos(data, pos, util::codec_t(encoding), lenlen, known_len);
 }
 
-std::string unpack_unicode(const data_t& data, int pos, int lenlen = 2)
+std::string unpack_unicode(data_view_t data, int pos, int lenlen = 2)
 {
     int nchars = calc_nchars(data, pos, lenlen);
 
@@ -80,7 +92,7 @@ std::string unpack_unicode(const data_t& data, int pos, int lenlen = 2)
     }
 
     pos += lenlen;
-    auto options = (unsigned char)data.data()[pos];
+    auto options = std::get<0>(data.unpack<pytype_B>(pos));
     pos += 1;
 
     std::string strg;
@@ -120,7 +132,7 @@ std::string unpack_unicode(const data_t& data, int pos, int lenlen = 2)
     return strg;
 }
 
-std::pair<std::string, int> unpack_unicode_update_pos(const data_t& data, size_t pos, int lenlen = 2, int known_len = -1)
+std::pair<std::string, int> unpack_unicode_update_pos(data_view_t data, int pos, int lenlen = 2, int known_len = -1)
 {
     int nchars;
     if (known_len != -1) {
@@ -134,7 +146,7 @@ std::pair<std::string, int> unpack_unicode_update_pos(const data_t& data, size_t
         return { "", pos };
     }
 
-    auto options = (unsigned char)data.data()[pos];
+    auto options = std::get<0>(data.unpack<pytype_B>(pos));
     pos += 1;
     auto phonetic = options & 0x04;
     auto richtext = options & 0x08;
@@ -142,11 +154,11 @@ std::pair<std::string, int> unpack_unicode_update_pos(const data_t& data, size_t
     int rt, sz;
     std::string strg;
     if (richtext != 0) {
-        rt = std::get<0>(data.slice(pos, pos + 2).unpack<pytype_H>());
+        rt = std::get<0>(data.unpack<pytype_H>(pos));
         pos += 2;
     }
     if (phonetic) {
-        sz = std::get<0>(data.slice(pos, pos + 4).unpack<pytype_i>());
+        sz = std::get<0>(data.unpack<pytype_i>(pos));
         pos += 4;
     }
     if (options & 0x01) {
@@ -169,7 +181,7 @@ std::pair<std::string, int> unpack_unicode_update_pos(const data_t& data, size_t
     return { strg, pos };
 }
 
-int unpack_cell_range_address_list_update_pos(std::vector<pytype_H>& output_list, const data_t data, int pos, int addr_size = 6)
+int unpack_cell_range_address_list_update_pos(std::vector<pytype_H>& output_list, data_view_t data, int pos, int addr_size = 6)
 {
     // output_list is updated in situ
     if (addr_size != 6 and addr_size != 8) {
@@ -179,18 +191,17 @@ int unpack_cell_range_address_list_update_pos(std::vector<pytype_H>& output_list
         return -1;
     }
 
-    uint16_t n = std::get<0>(data.slice(pos, pos + 2).unpack<pytype_H>());
+    uint16_t n = std::get<0>(data.unpack<pytype_H>(pos));
     pos += 2;
 
     for (int i = 0; i < n; i++) {
-        auto slice = data.slice(pos, pos + addr_size);
         int ra, rb, ca, cb;
         if (addr_size == 6) {
             // <HHBB
-            std::tie(ra, rb, ca, cb) = slice.unpack<pytype_H, pytype_H, pytype_B, pytype_B>();
+            std::tie(ra, rb, ca, cb) = data.unpack<pytype_H, pytype_H, pytype_B, pytype_B>(pos);
         } else { // addr_size = 8
             // <HHHH
-            std::tie(ra, rb, ca, cb) = slice.unpack<pytype_H, pytype_H, pytype_H, pytype_H>();
+            std::tie(ra, rb, ca, cb) = data.unpack<pytype_H, pytype_H, pytype_H, pytype_H>(pos);
         }
         output_list.push_back(ra);
         output_list.push_back(rb);
@@ -202,26 +213,84 @@ int unpack_cell_range_address_list_update_pos(std::vector<pytype_H>& output_list
     return pos;
 }
 
-void hex_char_dump(const std::string& strg, int ofs, int dlen, int base = 0, std::ostream& fout = std::cout, bool unnumbered = false)
+std::optional<dimensions_t> unpack_dimensions(data_view_t data, int biff_version)
 {
-    int endpos = std::min<int>(ofs + dlen, strg.length());
+    if (biff_version >= 80) {
+        // 32-bit rows: 12 bytes, then 2 reserved
+        if (data.size() < 12) {
+            return std::nullopt;
+        }
+        auto [first_row, last_row_plus1, first_col, last_col_plus1] = data.unpack<pytype_I, pytype_I, pytype_H, pytype_H>();
+        return dimensions_t { first_row, last_row_plus1, first_col, last_col_plus1 };
+    }
+    if (data.size() >= 8) {
+        auto [first_row, last_row_plus1, first_col, last_col_plus1] = data.unpack<pytype_H, pytype_H, pytype_H, pytype_H>();
+        return dimensions_t { first_row, last_row_plus1, first_col, last_col_plus1 };
+    }
+    return std::nullopt;
+}
+
+formula_result_t unpack_formula_result(data_view_t data)
+{
+    using kind_t = formula_result_t::kind_t;
+    // the last two bytes of the result are 0xFFFF if it isn't a number
+    auto [marker] = data.unpack<pytype_H>(12);
+    if (marker != 0xFFFF) {
+        return { kind_t::number, std::get<0>(data.unpack<pytype_d>(6)) };
+    }
+    // the type is in the first byte of the result, the value in the third
+    auto [result_type] = data.unpack<pytype_B>(6);
+    auto [result_value] = data.unpack<pytype_B>(8);
+    switch (result_type) {
+    case 0:
+        return { kind_t::string, 0.0 };
+    case 1:
+        return { kind_t::boolean, result_value != 0 ? 1.0 : 0.0 };
+    case 2:
+        return { kind_t::error, static_cast<double>(result_value) };
+    case 3:
+        return { kind_t::empty_string, 0.0 };
+    default:
+        return { kind_t::unknown, 0.0 };
+    }
+}
+
+std::optional<mulblank_t> mulblank_header(data_view_t data)
+{
+    // row, first column, an XF index per cell, last column
+    if (data.size() < 8) {
+        return std::nullopt;
+    }
+    auto [row, first_col] = data.unpack<pytype_H, pytype_H>();
+    return mulblank_t { row, first_col, (data.size() - 6) / 2 };
+}
+
+std::string unpack_cell_text(data_view_t data, int pos, int biff_version, const util::codec_t& codec)
+{
+    return biff_version >= 80 ? unpack_unicode(data, pos, 2) : unpack_string(data, pos, codec, 2);
+}
+
+void hex_char_dump(data_view_t strg, int ofs, int dlen, int base = 0, std::ostream& fout = std::cout, bool unnumbered = false)
+{
+    int endpos = std::min<int>(ofs + dlen, strg.size());
     int pos = ofs;
     bool numbered = not unnumbered;
     std::string num_prefix = "";
     while (pos < endpos) {
         int endsub = std::min<int>(pos + 16, endpos);
         size_t lensub = endsub - pos;
-        std::string substrg = strg.substr(pos, lensub);
-        if (lensub <= 0 or lensub != substrg.length()) {
+        auto substrg = strg.slice(pos, pos + lensub);
+        if (lensub <= 0 or lensub != substrg.size()) {
             fout << std::format(
                 "'??? hex_char_dump: ofs=%d dlen=%d base=%d -> endpos=%d pos=%d endsub=%d substrg=%r\n",
-                ofs, dlen, base, endpos, pos, endsub, substrg);
+                ofs, dlen, base, endpos, pos, endsub, substrg.to_string());
             break;
         }
 
         std::string hexd;
         std::string chard;
-        for (char c : substrg) {
+        for (auto b : substrg) {
+            auto c = static_cast<char>(b);
             hexd += std::format("%02x ", c);
 
             if (c == '\0') {
@@ -240,31 +309,32 @@ void hex_char_dump(const std::string& strg, int ofs, int dlen, int base = 0, std
     }
 }
 
-void biff_dump(const data_t& mem, int stream_offset, int stream_len, int base = 0, std::ostream& fout = std::cout, bool unnumbered = false)
+// true if the rest of the stream is zero padding
+static bool all_null(data_view_t rest)
 {
-    int pos = stream_offset;
-    int stream_end = stream_offset + stream_len;
-    int adj = base - stream_offset;
+    return std::all_of(rest.begin(), rest.end(), [](std::byte b) { return b == std::byte { 0 }; });
+}
+
+void biff_dump(data_view_t mem, int stream_offset, int stream_len, int base = 0, std::ostream& fout = std::cout, bool unnumbered = false)
+{
+    auto stream = mem.slice(stream_offset, stream_offset + stream_len);
+    record_cursor_t records(stream);
+    int adj = base;
     int dummies = 0;
     bool numbered = not unnumbered;
-    int savpos, length, rc;
+    bool overrun = false;
+    int savpos = 0;
+    size_t length = 0;
     std::string num_prefix;
 
-    while (stream_end - pos >= 4) {
-        std::tie(rc, length) = mem.slice(pos, pos + 4).unpack<pytype_H, pytype_H>();
-        if (rc == 0 and length == 0) {
-            bool allNull = true;
-            for (auto it = mem.begin() + pos; it != mem.end(); it++) {
-                if ((unsigned char)*it != '\0') {
-                    allNull = false;
-                    break;
-                }
-            }
-
-            if (allNull) {
-                dummies = stream_end - pos;
+    while (auto rec = records.next()) {
+        int pos = rec->offset;
+        length = rec->length;
+        if (rec->opcode == 0 and rec->length == 0) {
+            if (all_null(stream.slice(pos, stream.size()))) {
+                dummies = stream.size() - pos;
                 savpos = pos;
-                pos = stream_end;
+                records.seek(stream.size());
                 break;
             }
             if (dummies != 0) {
@@ -273,7 +343,6 @@ void biff_dump(const data_t& mem, int stream_offset, int stream_len, int base =
                 savpos = pos;
                 dummies = 4;
             }
-            pos += 4;
         } else {
             if (dummies != 0) {
                 if (numbered) {
@@ -282,7 +351,7 @@ void biff_dump(const data_t& mem, int stream_offset, int stream_len, int base =
                 fout << std::format("%s---- %d zero bytes skipped ----\n", num_prefix, dummies);
                 dummies = 0;
             }
-            std::string recname = biff_rec_name_dict.at(rc);
+            std::string recname(biff_rec_name(rec->opcode));
             if (recname.empty()) {
                 recname = "<UNKNOWN>";
             }
@@ -290,11 +359,9 @@ void biff_dump(const data_t& mem, int stream_offset, int stream_len, int base =
             if (numbered) {
                 num_prefix = std::format("%5d: ", adj + pos);
             }
-            fout << std::format("%s%04x %s len = %04x (%d)\n", num_prefix, rc, recname, length, length);
-            pos += 4;
-            std::string strg(reinterpret_cast<const char*>(mem.data()), mem.size());
-            hex_char_dump(strg, pos, length, adj + pos, fout, unnumbered);
-            pos += length;
+            fout << std::format("%s%04x %s len = %04x (%d)\n", num_prefix, rec->opcode, recname, length, length);
+            hex_char_dump(rec->payload, 0, rec->payload.size(), adj + pos + 4, fout, unnumbered);
+            overrun = rec->payload.size() < length;
         }
     }
     if (dummies != 0) {
@@ -303,52 +370,38 @@ void biff_dump(const data_t& mem, int stream_offset, int stream_len, int base =
         }
         fout << std::format("%s---- %d zero bytes skipped ----\n", num_prefix, dummies);
     }
-    if (pos < stream_end) {
+    int pos = records.tell();
+    if (overrun) {
+        fout << std::format("Last dumped record has length (%d) that is too large\n", length);
+    } else if (pos < stream.size()) {
         if (numbered) {
             num_prefix = std::format("%5d: ", adj + pos);
         }
         fout << std::format("%s---- Misc bytes at end ----\n", num_prefix);
-        std::string strg(reinterpret_cast<const char*>(mem.data()), mem.size());
-        hex_char_dump(strg, pos, stream_end - pos, adj + pos, fout, unnumbered);
-    } else if (pos > stream_end) {
-        fout << std::format("Last dumped record has length (%d) that is too large\n", length);
+        hex_char_dump(stream, pos, stream.size() - pos, adj + pos, fout, unnumbered);
     }
 }
 
-void biff_count_records(const data_t& mem, int stream_offset, int stream_len, std::ostream& fout)
+void biff_count_records(data_view_t mem, int stream_offset, int stream_len, std::ostream& fout)
 {
-    int pos = stream_offset;
-    int stream_end = stream_offset + stream_len;
+    auto stream = mem.slice(stream_offset, stream_offset + stream_len);
+    record_cursor_t records(stream);
     std::map<std::string, int> tally;
 
-    while (stream_end - pos >= 4) {
+    while (auto rec = records.next()) {
         std::string recname;
-        auto [rc, length] = mem.slice(pos, pos + 4).unpack<pytype_H, pytype_H>();
-        if (rc == 0 and length == 0) {
-            bool allNull = true;
-            for (auto it = mem.begin() + pos; it != mem.end(); it++) {
-                if ((unsigned char)*it != '\0') {
-                    allNull = false;
-                    break;
-                }
-            }
-            if (allNull) {
+        if (rec->opcode == 0 and rec->length == 0) {
+            if (all_null(stream.slice(rec->offset, stream.size()))) {
                 break;
             }
-
             recname = "<Dummy (zero)>";
         } else {
-            recname = biff_rec_name_dict.at(rc);
+            recname = biff_rec_name(rec->opcode);
             if (recname.empty()) {
-                recname = std::format("Unknown_0x%04X", rc);
+                recname = std::format("Unknown_0x%04X", rec->opcode);
             }
         }
-        if (tally.contains(recname)) {
-            tally[recname] += 1;
-        } else {
-            tally.insert({ recname, 1 });
-        }
-        pos += length + 4;
+        tally[recname] += 1;
     }
     for (const auto& [recname, count] : tally) {
         fout << std::format("%8d %s\n", count, recname);
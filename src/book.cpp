@@ -1,8 +1,534 @@
 #include "excelr8/book.hpp"
+#include "excelr8/biff.hpp"
+#include "excelr8/compdoc.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <exception>
+#include <format>
 #include <iostream>
+#include <system_error>
+#include <thread>
 
 namespace excelr8::book {
     void Book::derive_encoding() {
-        // TODO
+        if (!encoding_override.empty()) {
+            encoding = encoding_override;
+        } else if (codepage == -1) {
+            if (biff_version < 80) {
+                std::cerr << "*** No CODEPAGE record, no encoding_override: will use 'iso-8859-1'" << std::endl;
+                encoding = "iso-8859-1";
+            } else {
+                codepage = 1200; // utf16le
+                encoding = "utf_16_le";
+            }
+        } else {
+            std::string derived;
+            auto it = biff::encoding_from_codepage.find(codepage);
+            if (it != biff::encoding_from_codepage.end()) {
+                derived = it->second;
+            } else if (300 <= codepage and codepage <= 1999) {
+                derived = "cp" + std::to_string(codepage);
+            } else {
+                derived = "unknown_codepage_" + std::to_string(codepage);
+            }
+            if (verbosity and derived != encoding) {
+                std::cerr << std::format("CODEPAGE: codepage {} -> encoding {}\n", codepage, derived);
+            }
+            encoding = derived;
+        }
+
+        // Resolved once here: a compile-time table for the common
+        // single-byte codepages, else a pooled ICU converter
+        codec = util::codec_t(encoding);
+        if (codec.kind() == util::codec_t::kind_t::icu) {
+            // If we don't have a codec that can decode ASCII, we're well &
+            // truly stuffed -- let the punter know ASAP.
+            std::string_view trial = "trial";
+            if (codec.decode(data_view_t(reinterpret_cast<const std::byte*>(trial.data()), trial.size())) != trial) {
+                throw biff::Excelr8Error(std::format("codepage {} -> encoding {}: not supported", codepage, encoding));
+            }
+        }
+
+        if (raw_user_name) {
+            auto raw = data_t(user_name);
+            user_name = biff::unpack_string(data_view_t(raw), 0, codec, 1);
+            user_name.erase(user_name.find_last_not_of(' ') + 1);
+            raw_user_name = false;
+        }
+    }
+
+    Book::Book(std::pmr::memory_resource* upstream)
+        : arena(upstream) {
+    }
+
+    void Book::biff2_8_load(std::shared_ptr<const byte_source_t> source, bool ignore_workbook_corruption) {
+        std::byte head[8] {};
+        source->read(0, sizeof(head), head);
+        if (data_view_t(head, sizeof(head)) != data_view_t(compdoc::SIGNATURE)) {
+            // a bare BIFF stream
+            workbook_stream = stream_view_t(std::move(source));
+            return;
+        }
+
+        compdoc::CompDoc cd(source, std::cout, 0, ignore_workbook_corruption, &arena);
+        for (const char* qname : { "Workbook", "Book" }) {
+            if (auto stream = cd.locate_named_stream(qname)) {
+                workbook_stream = std::move(*stream);
+                return;
+            }
+        }
+        throw biff::Excelr8Error("Can't find workbook in OLE2 compound document");
+    }
+
+    int Book::getbof(biff::record_cursor_t& cursor, int rqd_stream) const {
+        auto bof_error = [](const std::string& msg) {
+            throw biff::Excelr8Error("Unsupported format, or corrupt file: " + msg);
+        };
+        auto rec = cursor.next();
+        if (!rec) {
+            bof_error("Expected BOF record; met end of file");
+        }
+        int opcode = rec->opcode;
+        if (std::find(biff::bofcodes.begin(), biff::bofcodes.end(), opcode) == biff::bofcodes.end()) {
+            bof_error(std::format("Expected BOF record; found 0x{:04x}", opcode));
+        }
+        if (rec->length < 4 or rec->length > 20) {
+            bof_error(std::format("Invalid length ({}) for BOF record type 0x{:04x}", rec->length, opcode));
+        }
+        if (rec->payload.size() < rec->length) {
+            bof_error("Incomplete BOF record[2]; met end of file");
+        }
+        // short BOF records are zero-padded to their nominal length
+        std::byte padded[20] {};
+        std::memcpy(padded, rec->payload.data(), rec->payload.size());
+        data_view_t data(padded, sizeof(padded));
+
+        int version1 = opcode >> 8;
+        auto [version2, streamtype] = data.unpack<pytype_H, pytype_H>();
+        int version = 0;
+        if (version1 == 0x08) {
+            auto [build, year] = data.unpack<pytype_H, pytype_H>(4);
+            if (version2 == 0x0600) {
+                version = 80;
+            } else if (version2 == 0x0500) {
+                if (year < 1994 or build == 2412 or build == 3218 or build == 3321) {
+                    version = 50;
+                } else {
+                    version = 70;
+                }
+            } else {
+                // dodgy one, created by a 3rd-party tool
+                switch (version2) {
+                case 0x0000:
+                case 0x0007:
+                case 0x0200:
+                    version = 21;
+                    break;
+                case 0x0300:
+                    version = 30;
+                    break;
+                case 0x0400:
+                    version = 40;
+                    break;
+                }
+            }
+        } else {
+            version = version1 == 0x04 ? 40 : version1 == 0x02 ? 30 : 21;
+        }
+
+        if (version == 40 and streamtype == biff::XL_WORKBOOK_GLOBALS_4W) {
+            version = 45; // i.e. 4W
+        }
+        bool got_globals = streamtype == biff::XL_WORKBOOK_GLOBALS
+            or (version == 45 and streamtype == biff::XL_WORKBOOK_GLOBALS_4W);
+        if ((rqd_stream == biff::XL_WORKBOOK_GLOBALS and got_globals) or streamtype == rqd_stream) {
+            return version;
+        }
+        if (version < 50 and streamtype == biff::XL_WORKSHEET) {
+            return version;
+        }
+        if (version >= 50 and streamtype == 0x0100) {
+            bof_error("Workspace file -- no spreadsheet data");
+        }
+        bof_error(std::format("BOF not workbook/worksheet: op=0x{:04x} vers=0x{:04x} strm=0x{:04x} -> BIFF{}", opcode, version2, streamtype, version));
+        return 0;
+    }
+
+    void Book::parse_globals() {
+        biff::record_cursor_t cursor(workbook_stream);
+        biff_version = getbof(cursor, biff::XL_WORKBOOK_GLOBALS);
+        if (biff_version == 45) {
+            throw biff::Excelr8Error("BIFF4W workbooks are not supported");
+        }
+        if (biff_version < 45) {
+            // A worksheet file: no globals, just the one sheet
+            _sheet_names = { "Sheet1" };
+            _sheet_visibility = { 0 };
+            _sh_abs_posn = { 0 };
+            _sheet_list.resize(1);
+            nsheets = 1;
+            read_worksheet_settings(cursor);
+            return;
+        }
+
+        while (!cursor.eof()) {
+            auto opcode = *cursor.peek_opcode();
+            if (opcode == biff::XL_SST) {
+                handle_sst(cursor);
+                continue;
+            }
+            auto rec = cursor.next();
+            data_view_t data = rec->payload;
+            switch (opcode) {
+            case biff::XL_FONT:
+            case biff::XL_FONT_B3B4:
+                formatting::handle_font(*this, data);
+                break;
+            case biff::XL_EFONT:
+                formatting::handle_efont(*this, data);
+                break;
+            case biff::XL_BOUNDSHEET:
+                handle_boundsheet(data);
+                break;
+            case biff::XL_DATEMODE:
+                handle_datemode(data);
+                break;
+            case biff::XL_CODEPAGE:
+                handle_codepage(data);
+                break;
+            case biff::XL_COUNTRY:
+                handle_country(data);
+                break;
+            case biff::XL_WRITEACCESS:
+                handle_writeaccess(data);
+                break;
+            case biff::XL_EOF:
+                if (encoding.empty()) {
+                    derive_encoding();
+                }
+                nsheets = _sheet_names.size();
+                _sheet_list.resize(nsheets);
+                return;
+            }
+        }
+        throw biff::Excelr8Error("Workbook globals have no EOF record");
+    }
+
+    void Book::read_worksheet_settings(biff::record_cursor_t& cursor) {
+        // CODEPAGE and DATEMODE come before the sheet's dimensions and cells
+        while (auto opcode = cursor.peek_opcode()) {
+            auto cls = biff::record_info(*opcode).cls;
+            if (*opcode == biff::XL_DIMENSION or *opcode == biff::XL_DIMENSION2 or *opcode == biff::XL_ROW
+                or cls == biff::record_class_t::cell or cls == biff::record_class_t::bof or cls == biff::record_class_t::eof) {
+                break;
+            }
+            if (*opcode == biff::XL_CODEPAGE) {
+                handle_codepage(cursor.next()->payload);
+            } else if (*opcode == biff::XL_DATEMODE) {
+                handle_datemode(cursor.next()->payload);
+            } else {
+                cursor.skip();
+            }
+        }
+        if (encoding.empty()) {
+            derive_encoding();
+        }
+    }
+
+    workbook_info_t Book::scan_info() {
+        workbook_info_t info;
+        biff::record_cursor_t cursor(workbook_stream);
+        biff_version = getbof(cursor, biff::XL_WORKBOOK_GLOBALS);
+        if (biff_version == 45) {
+            throw biff::Excelr8Error("BIFF4W workbooks are not supported");
+        }
+
+        // Reads a worksheet from just past its BOF up to its DIMENSIONS
+        // record, or to the first record that can only follow it
+        auto scan_sheet = [&](sheet_info_t& sh) {
+            while (auto opcode = cursor.peek_opcode()) {
+                sh.nrecords++;
+                auto cls = biff::record_info(*opcode).cls;
+                if (*opcode == biff::XL_DIMENSION or *opcode == biff::XL_DIMENSION2) {
+                    if (auto dims = biff::unpack_dimensions(cursor.next()->payload, biff_version)) {
+                        sh.has_dimension = true;
+                        sh.first_row = dims->first_row;
+                        sh.nrows = dims->nrows;
+                        sh.first_col = dims->first_col;
+                        sh.ncols = dims->ncols;
+                    }
+                    return;
+                }
+                if (*opcode == biff::XL_ROW or cls == biff::record_class_t::cell or cls == biff::record_class_t::bof or cls == biff::record_class_t::eof) {
+                    cursor.skip();
+                    return;
+                }
+                cursor.skip();
+            }
+        };
+
+        if (biff_version < 45) {
+            // A worksheet file: no globals, just the one sheet
+            uint64_t sheet_start = cursor.tell();
+            read_worksheet_settings(cursor);
+            cursor.seek(sheet_start);
+            info.sheets.push_back({ .name = "Sheet1", .nrecords = 1 });
+            scan_sheet(info.sheets.back());
+        } else {
+            info.nglobal_records = 1;
+            bool eof = false;
+            while (!eof) {
+                auto opcode = cursor.peek_opcode();
+                if (!opcode) {
+                    throw biff::Excelr8Error("Workbook globals have no EOF record");
+                }
+                info.nglobal_records++;
+                switch (*opcode) {
+                case biff::XL_BOUNDSHEET:
+                    info.sheets.push_back(handle_boundsheet(cursor.next()->payload));
+                    break;
+                case biff::XL_CODEPAGE:
+                    handle_codepage(cursor.next()->payload);
+                    break;
+                case biff::XL_DATEMODE:
+                    handle_datemode(cursor.next()->payload);
+                    break;
+                case biff::XL_EOF:
+                    cursor.skip();
+                    if (encoding.empty()) {
+                        derive_encoding();
+                    }
+                    nsheets = _sheet_names.size();
+                    _sheet_list.resize(nsheets);
+                    eof = true;
+                    break;
+                default:
+                    // SST, FONT, XF, ... are not decoded
+                    cursor.skip();
+                    break;
+                }
+            }
+            for (auto& sh : info.sheets) {
+                if (sh.type != biff::XL_BOUNDSHEET_WORKSHEET) {
+                    continue;
+                }
+                cursor.seek(sh.offset);
+                getbof(cursor, biff::XL_WORKSHEET);
+                sh.nrecords = 1;
+                scan_sheet(sh);
+            }
+        }
+
+        info.biff_version = biff_version;
+        info.codepage = codepage;
+        info.encoding = encoding;
+        info.datemode = datemode;
+        info.nrecords = info.nglobal_records;
+        for (const auto& sh : info.sheets) {
+            info.nrecords += sh.nrecords;
+        }
+        return info;
+    }
+
+    sheet_info_t Book::handle_boundsheet(data_view_t data) {
+        derive_encoding();
+        auto [offset, visibility, sheet_type] = data.unpack<pytype_i, pytype_B, pytype_B>();
+        sheet_info_t sheet {
+            .name = biff_version < 80
+                ? biff::unpack_string(data, 6, codec, 1)
+                : biff::unpack_unicode(data, 6, 1),
+            .type = sheet_type,
+            .visibility = visibility,
+            .offset = static_cast<uint32_t>(offset),
+        };
+        if (sheet_type != biff::XL_BOUNDSHEET_WORKSHEET) {
+            // charts, macro sheets and VB modules are not loaded
+            return sheet;
+        }
+        _sheet_names.push_back(sheet.name);
+        _sh_abs_posn.push_back(static_cast<uint32_t>(offset));
+        _sheet_visibility.push_back(visibility);
+        return sheet;
+    }
+
+    void Book::handle_codepage(data_view_t data) {
+        codepage = std::get<0>(data.unpack<pytype_H>());
+        derive_encoding();
+    }
+
+    void Book::handle_country(data_view_t data) {
+        auto [ui, regional] = data.unpack<pytype_H, pytype_H>();
+        countries = { ui, regional };
+    }
+
+    void Book::handle_datemode(data_view_t data) {
+        auto [mode] = data.unpack<pytype_H>();
+        if (mode != 0 and mode != 1) {
+            throw biff::Excelr8Error(std::format("DATEMODE record has unexpected value {}", mode));
+        }
+        datemode = static_cast<int8_t>(mode);
+    }
+
+    void Book::handle_writeaccess(data_view_t data) {
+        if (biff_version < 80) {
+            if (encoding.empty()) {
+                // decoded by derive_encoding() once the codepage is known
+                raw_user_name = true;
+                user_name = data.to_string();
+                return;
+            }
+            user_name = biff::unpack_string(data, 0, codec, 1);
+        } else {
+            user_name = biff::unpack_unicode(data, 0, 2);
+        }
+        user_name.erase(user_name.find_last_not_of(' ') + 1);
+    }
+
+    void Book::handle_sst(biff::record_cursor_t& cursor) {
+        // The joined SST payload stays valid while EXTSST, which follows
+        // the SST and its CONTINUEs, is read with next().
+        uint64_t sst_offset = cursor.tell();
+        auto sst = cursor.next_joined();
+        data_view_t extsst;
+        if (cursor.peek_opcode() == biff::XL_EXTSST) {
+            extsst = cursor.next()->payload;
+        }
+        if (lazy_sst) {
+            shared_strings = index_sst_table(sst->payload, cursor.segments(), &arena);
+        } else {
+            shared_strings = unpack_sst_table(sst->payload, cursor.segments(), extsst, sst_offset, nthreads, &arena);
+        }
+    }
+
+    std::unique_ptr<sheet::Sheet> Book::_parse_sheet(size_t sheetx) const {
+        // Each call has its own cursor; the stream, codec and shared
+        // strings are only read.
+        biff::record_cursor_t cursor(workbook_stream);
+        cursor.seek(_sh_abs_posn.at(sheetx));
+        getbof(cursor, biff::XL_WORKSHEET);
+
+        // not the arena: an unloaded sheet's cells are given back
+        auto sh = std::make_unique<sheet::Sheet>(arena.upstream_resource());
+        sh->name = _sheet_names[sheetx];
+        sh->number = static_cast<int>(sheetx);
+        sh->visibility = _sheet_visibility[sheetx];
+        sh->shared_strings = &shared_strings;
+        sh->read(*this, cursor, projection);
+        sh->shrink_to_fit();
+        return sh;
+    }
+
+    sheet::Sheet& Book::get_sheet(size_t sheetx) {
+        _sheet_list.at(sheetx) = _parse_sheet(sheetx);
+        return *_sheet_list[sheetx];
+    }
+
+    void Book::get_sheets() {
+        std::vector<bool> wanted(nsheets, sheet_subset.empty());
+        for (const auto& sheet_name : sheet_subset) {
+            auto it = std::find(_sheet_names.begin(), _sheet_names.end(), sheet_name);
+            if (it == _sheet_names.end()) {
+                throw biff::Excelr8Error(std::format("No sheet named <{}>", sheet_name));
+            }
+            wanted[it - _sheet_names.begin()] = true;
+        }
+        std::vector<size_t> pending;
+        for (size_t sheetx = 0; sheetx < nsheets; sheetx++) {
+            if (wanted[sheetx] and !_sheet_list[sheetx]) {
+                pending.push_back(sheetx);
+            }
+        }
+        unsigned workers_wanted = nthreads == 0 ? std::max(1u, std::thread::hardware_concurrency()) : nthreads;
+        size_t nworkers = std::min<size_t>(workers_wanted, pending.size());
+        if (nworkers <= 1) {
+            for (auto sheetx : pending) {
+                get_sheet(sheetx);
+            }
+            return;
+        }
+
+        // Workers take the next pending sheet until none are left; results
+        // are only stored once all are done, in workbook order.
+        std::vector<std::unique_ptr<sheet::Sheet>> results(pending.size());
+        std::vector<std::exception_ptr> errors(pending.size());
+        std::atomic<size_t> next = 0;
+        auto work = [&] {
+            for (size_t i; (i = next.fetch_add(1)) < pending.size();) {
+                try {
+                    results[i] = _parse_sheet(pending[i]);
+                } catch (...) {
+                    errors[i] = std::current_exception();
+                }
+            }
+        };
+        std::vector<std::thread> workers;
+        try {
+            for (size_t w = 1; w < nworkers; w++) {
+                workers.emplace_back(work);
+            }
+        } catch (const std::system_error&) {
+            // no more threads to be had: the ones running and the calling
+            // thread take all the sheets between them
+        }
+        work();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+
+        for (size_t i = 0; i < pending.size(); i++) {
+            if (errors[i]) {
+                std::rethrow_exception(errors[i]);
+            }
+            _sheet_list[pending[i]] = std::move(results[i]);
+        }
+    }
+
+    const std::vector<std::string>& Book::sheet_names() const {
+        return _sheet_names;
+    }
+
+    sheet::Sheet& Book::sheet_by_index(size_t sheetx) {
+        if (sheetx >= nsheets) {
+            throw std::out_of_range(std::format("sheet index {} out of range", sheetx));
+        }
+        if (!_sheet_list[sheetx]) {
+            return get_sheet(sheetx);
+        }
+        return *_sheet_list[sheetx];
+    }
+
+    sheet::Sheet& Book::sheet_by_name(const std::string& sheet_name) {
+        auto it = std::find(_sheet_names.begin(), _sheet_names.end(), sheet_name);
+        if (it == _sheet_names.end()) {
+            throw biff::Excelr8Error(std::format("No sheet named <{}>", sheet_name));
+        }
+        return sheet_by_index(it - _sheet_names.begin());
+    }
+
+    bool Book::sheet_loaded(size_t sheetx) const {
+        if (sheetx >= nsheets) {
+            throw std::out_of_range(std::format("sheet index {} out of range", sheetx));
+        }
+        return _sheet_list[sheetx] != nullptr;
+    }
+
+    void Book::unload_sheet(size_t sheetx) {
+        if (sheetx >= nsheets) {
+            throw std::out_of_range(std::format("sheet index {} out of range", sheetx));
+        }
+        _sheet_list[sheetx].reset();
+    }
+
+    std::shared_ptr<const sheet::row_index_t> Book::row_index(size_t sheetx) const {
+        if (sheetx >= nsheets) {
+            throw std::out_of_range(std::format("sheet index {} out of range", sheetx));
+        }
+        std::lock_guard lock(_row_indexes_mutex);
+        _row_indexes.resize(nsheets);
+        if (!_row_indexes[sheetx]) {
+            _row_indexes[sheetx] = std::make_shared<const sheet::row_index_t>(sheet::row_index_t::build(*this, sheetx));
+        }
+        return _row_indexes[sheetx];
     }
-}
\ No newline at end of file
+}
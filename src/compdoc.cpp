@@ -2,80 +2,115 @@
 #include "excelr8/data.hpp"
 #include "excelr8/util.hpp"
 #include <cassert>
+#include <cctype>
+#include <cstddef>
+#include <algorithm>
 #include <format>
-#include <sstream>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <tuple>
 #include <utility>
 #include <vector>
 
 namespace excelr8::compdoc {
 
-DirNode::DirNode(int did, const data_t dent, int debug, std::ostream& logfile)
-    : logfile(logfile)
-    , did(did)
+std::string_view dir_table_t::name(int did) const
+{
+    uint32_t start = did > 0 ? name_end[did - 1] : 0;
+    return std::string_view(names).substr(start, name_end[did] - start);
+}
+
+std::span<const int32_t> dir_table_t::children(int did) const
+{
+    return std::span<const int32_t>(kids).subspan(kids_first[did], kids_count[did]);
+}
+
+void dir_table_t::append(data_view_t dent, int major_version)
 {
-    pytype_H cbufsize;
-    std::tie(cbufsize, etype, color, left_did, right_did, root_did)
+    auto [cbufsize, etype, color, left_did, right_did, root_did]
         = dent.slice(64, 80).unpack<pytype_H, pytype_B, pytype_B, pytype_i, pytype_i, pytype_i>();
-    std::tie(first_sid, tot_size) = dent.slice(116, 124).unpack<pytype_i, pytype_i>();
+    auto [first_sid, size_lo, size_hi] = dent.unpack<pytype_i, pytype_I, pytype_I>(116);
+    auto [cre_lo, cre_hi, mod_lo, mod_hi] = dent.slice(100, 116).unpack<pytype_I, pytype_I, pytype_I, pytype_I>();
 
     if (cbufsize != 0) {
-        name = util::unicode(dent.slice(0, cbufsize - 2), "utf_16_le"); // omit the trailing U+0000
-    }
-    std::tie(tsinfo[0], tsinfo[1], tsinfo[2], tsinfo[3]) = dent.slice(100, 116).unpack<pytype_I, pytype_I, pytype_I, pytype_I>();
-
-    if (debug) {
-        dump(debug);
-    }
+        names += util::unicode(dent.slice(0, cbufsize - 2), "utf_16_le"); // omit the trailing U+0000
+    }
+    name_end.push_back(static_cast<uint32_t>(names.size()));
+    this->etype.push_back(etype);
+    this->color.push_back(color);
+    this->left_did.push_back(left_did);
+    this->right_did.push_back(right_did);
+    this->root_did.push_back(root_did);
+    parent.push_back(-1);
+    this->first_sid.push_back(first_sid);
+    // Version 3 writers leave garbage in the high half; only version 4
+    // (4096-byte sectors) has 64-bit stream sizes.
+    tot_size.push_back(major_version >= 4 ? (static_cast<uint64_t>(size_hi) << 32) | size_lo : size_lo);
+    tsinfo.push_back({ cre_lo, cre_hi, mod_lo, mod_hi });
+    kids_first.push_back(0);
+    kids_count.push_back(0);
 }
 
-void DirNode::dump(int debug)
+void dir_table_t::dump(int did, std::ostream& logfile, int debug) const
 {
     logfile << std::format("DID=%d name=%s etype=%d DIDs(left=%d right=%d root=%d parent=%d kids size=%d) first_SID=%d tot_size=%d\n",
-        did, name, etype, left_did, right_did, root_did, parent, children.size(), first_sid, tot_size);
+        did, name(did), etype[did], left_did[did], right_did[did], root_did[did], parent[did], kids_count[did], first_sid[did], tot_size[did]);
 
     if (debug == 2) {
         // cre_lo, cre_hi, mod_lo, mod_hi = tsinfo
-        logfile << std::format("timestamp info %u %u %u %u\n", tsinfo[0], tsinfo[1], tsinfo[2], tsinfo[3]);
+        const auto& ts = tsinfo[did];
+        logfile << std::format("timestamp info %u %u %u %u\n", ts[0], ts[1], ts[2], ts[3]);
     }
 }
 
-void _build_family_tree(const std::vector<DirNode*>& dirlist, int parent_did, int child_did)
+CompDoc::CompDoc(data_view_t mem, std::ostream& logfile, int debug, bool ignore_workbook_corruption, std::pmr::memory_resource* resource, validation_t validation)
+    : CompDoc(std::make_shared<const memory_source_t>(mem), logfile, debug, ignore_workbook_corruption, resource, validation)
 {
-    if (child_did < 0)
-        return;
-
-    _build_family_tree(dirlist, parent_did, dirlist[child_did]->left_did);
-    dirlist[parent_did]->children.push_back(child_did);
-    dirlist[child_did]->parent = parent_did;
+}
 
-    _build_family_tree(dirlist, parent_did, dirlist[child_did]->right_did);
-    if (dirlist[child_did]->etype == 1) { // storage
-        _build_family_tree(dirlist, child_did, dirlist[child_did]->root_did);
-    }
+CompDoc::CompDoc(const std::filesystem::path& filename, std::ostream& logfile, int debug, bool ignore_workbook_corruption, std::pmr::memory_resource* resource, validation_t validation)
+    : CompDoc(std::make_shared<const mapped_file_t>(filename), logfile, debug, ignore_workbook_corruption, resource, validation)
+{
 }
 
-CompDoc::CompDoc(const data_t& mem, std::ostream& logfile, int debug, bool ignore_workbook_corruption)
+CompDoc::CompDoc(std::shared_ptr<const byte_source_t> source, std::ostream& logfile, int debug, bool ignore_workbook_corruption, std::pmr::memory_resource* resource, validation_t validation)
     : logfile(logfile)
     , ignore_workbook_corruption(ignore_workbook_corruption)
+    , validation(validation)
     , debug(debug)
-    , mem(mem)
+    , source(std::move(source))
+    , arena(resource)
+    , seen(&arena)
+    , SAT(&arena)
+    , SSAT(&arena)
 {
-    if (mem.slice(0, 8) != SIGNATURE) {
+    // The MSAT, SAT and directory sectors are scattered all over the file;
+    // keep the kernel from reading ahead until a stream is located.
+    uint64_t mem_size = this->source->size();
+    _advise(access_hint_t::random, 0, mem_size);
+
+    std::vector<std::byte> header_bytes(512);
+    header_bytes.resize(this->source->read(0, 512, header_bytes.data()));
+    data_t header(std::move(header_bytes));
+
+    if (header.slice(0, 8) != SIGNATURE) {
         throw CompDocError("Not an OLE2 compound document");
     }
-    auto le_marker = mem.slice(28, 30);
+    if (header.size() < 512) {
+        throw CompDocError("OLE2 header is truncated");
+    }
+    auto le_marker = header.slice(28, 30);
     if (le_marker != data_t("\xFE\xFF")) {
         throw CompDocError("Expected 'little-endian' marker, found " + le_marker.to_string());
     }
-    auto [revision, version] = mem.slice(24, 28).unpack<pytype_H, pytype_H>();
+    auto [revision, version] = header.slice(24, 28).unpack<pytype_H, pytype_H>();
 
     if (debug) {
         logfile << std::format("\nCompDoc format: version=0x%04x revision=0x%04x\n", version, revision);
     }
 
-    auto [ssz, sssz] = mem.slice(30, 34).unpack<pytype_H, pytype_H>();
+    auto [ssz, sssz] = header.slice(30, 34).unpack<pytype_H, pytype_H>();
     if (ssz > 20) { // allows for 2**20 bytes i.e. 1MB
         logfile << std::format("WARNING: sector size (2**%d) is preposterous; assuming 512 and continuing ...\n", ssz);
         ssz = 9;
@@ -91,7 +126,7 @@ CompDoc::CompDoc(const data_t& mem, std::ostream& logfile, int debug, bool ignor
         logfile << std::format("@@@@ sec_size=%d short_sec_size=%d\n", sec_size, short_sec_size);
     }
 
-    auto _info = mem.slice(44, 76).unpack_vec<pytype_i>(8);
+    auto _info = header.slice(44, 76).unpack_vec<pytype_i>(8);
     int SAT_tot_secs = _info[0];
     dir_first_sec_sid = _info[1];
     // _info[2] is unused
@@ -101,18 +136,22 @@ CompDoc::CompDoc(const data_t& mem, std::ostream& logfile, int debug, bool ignor
     int MSATX_first_sec_sid = _info[6];
     int MSATX_tot_secs = _info[7];
 
-    size_t mem_data_len = mem.size() - 512;
-    size_t mem_data_secs = mem_data_len / sec_size;
+    // The header occupies the whole of sector -1: 512 bytes in version 3,
+    // 4096 bytes in version 4.
+    uint64_t mem_data_len = mem_size > sec_size ? mem_size - sec_size : 0;
+    uint64_t mem_data_secs = mem_data_len / sec_size;
     int left_over = mem_data_len % sec_size;
     if (left_over) {
         // throw CompDocError("Not a whole number of sectors");
         mem_data_secs += 1;
-        logfile << std::format("WARNING *** file size (%d) not 512 + multiple of sector size (%d)\n", mem.size(), sec_size);
+        logfile << std::format("WARNING *** file size (%d) not header + multiple of sector size (%d)\n", mem_size, sec_size);
     }
 
     this->mem_data_secs = mem_data_secs; // use for checking later
     this->mem_data_len = mem_data_len;
-    seen = std::vector<unsigned char>(mem_data_secs, 0);
+    if (validation == validation_t::strict) {
+        seen.assign(mem_data_secs, 0);
+    }
 
     if (debug) {
         logfile << std::format("sec sizes %d %d %d %d\n", ssz, sssz, sec_size, short_sec_size);
@@ -128,7 +167,8 @@ CompDoc::CompDoc(const data_t& mem, std::ostream& logfile, int debug, bool ignor
     //
     // === build the MSAT ===
     //
-    std::vector<int> MSAT = mem.slice(76, 512).unpack_vec<int>(109);
+    auto msat_head = header.slice(76, 512).unpack_vec<int>(109);
+    std::pmr::vector<int> MSAT(msat_head.begin(), msat_head.end(), &arena);
     int SAT_sectors_reqd = (mem_data_secs + nent - 1) / nent;
     int expected_MSATX_sectors = std::max(0, (SAT_sectors_reqd - 109 + nent - 2) / (nent - 1));
     int actual_MSATX_sectors = 0;
@@ -155,17 +195,16 @@ CompDoc::CompDoc(const data_t& mem, std::ostream& logfile, int debug, bool ignor
             } else if (sid < 0) {
                 throw CompDocError("MSAT extension: invalid sector id: " + std::to_string(sid));
             }
-            if (seen[sid]) {
-                throw CompDocError(std::format("MSAT corruption: seen[%d] == %d", sid, seen[sid]));
-            }
-            seen[sid] = 1;
+            _claim_sector(sid, 1, "MSAT");
             actual_MSATX_sectors += 1;
+            if (actual_MSATX_sectors > mem_data_secs) {
+                throw CompDocError("MSAT extension: sector chain loops");
+            }
             if (debug and actual_MSATX_sectors > expected_MSATX_sectors) {
                 logfile << "[1]===>>> " << mem_data_secs << " " << nent << " " << SAT_sectors_reqd << " " << expected_MSATX_sectors << " " << actual_MSATX_sectors << std::endl;
             }
-            int offset = 512 + sec_size * sid;
-            auto extension = mem.slice(offset, offset + sec_size).unpack_vec<int>(nent);
-            MSAT.insert(MSAT.end(), extension.begin(), extension.end());
+            uint64_t offset = _sector_offset(sid);
+            _read_sids(offset, nent, MSAT);
             sid = MSAT.back();
             MSAT.pop_back(); // last sector id is sid of next sector in the chain
         }
@@ -184,6 +223,7 @@ CompDoc::CompDoc(const data_t& mem, std::ostream& logfile, int debug, bool ignor
     //
     int actual_SAT_sectors = 0;
     int dump_again = 0;
+    SAT.reserve(MSAT.size() * nent);
     for (size_t msidx = 0; msidx < MSAT.size(); msidx++) {
         int msid = MSAT[msidx];
         if (msid == FREESID or msid == EOCSID) {
@@ -203,17 +243,13 @@ CompDoc::CompDoc(const data_t& mem, std::ostream& logfile, int debug, bool ignor
         } else if (msid < -2) {
             throw CompDocError("MSAT: invalid sector id: " + std::to_string(msid));
         }
-        if (seen[msid]) {
-            throw CompDocError(std::format("MSAT extension corruption: seen[%d] == %d", msid, seen[msid]));
-        }
-        seen[msid] = 2;
+        _claim_sector(msid, 2, "MSAT extension");
         actual_SAT_sectors += 1;
         if (debug and actual_SAT_sectors > SAT_sectors_reqd) {
             logfile << std::format("[3]===>>> %d %d %d %d %d %d %d\n", mem_data_secs, nent, SAT_sectors_reqd, expected_MSATX_sectors, actual_MSATX_sectors, actual_SAT_sectors, msid);
         }
-        int offset = 512 + sec_size * msid;
-        std::vector<int> extension = mem.slice(offset, offset + sec_size).unpack_vec<int>(nent);
-        SAT.insert(SAT.end(), extension.begin(), extension.end());
+        uint64_t offset = _sector_offset(msid);
+        _read_sids(offset, nent, SAT);
     }
 
     if (debug) {
@@ -238,57 +274,88 @@ CompDoc::CompDoc(const data_t& mem, std::ostream& logfile, int debug, bool ignor
     //
     // === build the directory ===
     //
-    data_t dbytes = _get_stream(mem, 512, SAT, sec_size, dir_first_sec_sid, -1, "directory", 3);
-    std::vector<DirNode*> dirlist;
-    int did = -1;
-    for (size_t pos = 0; pos < dbytes.size(); pos += 128) {
-        did += 1;
-        dirlist.push_back(new DirNode(did, dbytes.slice(pos, pos + 128), 0, logfile));
-    }
-    this->dirlist = dirlist;
-    _build_family_tree(dirlist, 0, dirlist[0]->root_did); // and stand well back ...
+    auto dbytes = _get_stream(stream_view_t(this->source), sec_size, SAT, sec_size, dir_first_sec_sid, -1, "directory", 3);
+    while (dbytes.remaining() >= 128) {
+        dir.append(dbytes.next(128), version);
+    }
+    if (dir.size() == 0) {
+        throw CompDocError("Directory is empty");
+    }
+    _build_family_tree(); // and stand well back ...
+    _build_dir_index();
     if (debug) {
-        for (const auto& d : dirlist) {
-            d->dump(debug);
+        for (size_t did = 0; did < dir.size(); did++) {
+            dir.dump(did, logfile, debug);
         }
     }
 
+    // The SSCS and SSAT are only needed for streams smaller than
+    // min_size_std_stream, which the Workbook stream almost never is;
+    // they are resolved by _short_sectors() on first use.
+    this->SSAT_first_sec_sid = SSAT_first_sec_sid;
+    this->SSAT_tot_secs = SSAT_tot_secs;
+    // DID 0 is the root entry
+    assert(dir.etype[0] == 5);
+    if (SSAT_tot_secs > 0 and dir.tot_size[0] == 0) {
+        logfile << "WARNING *** OLE2 inconsistency: SSCS size is 0 but SSAT size is non-zero" << std::endl;
+    }
+}
+
+const stream_view_t& CompDoc::_short_sectors()
+{
+    if (sscs_loaded) {
+        return SSCS;
+    }
+    // the sector claims are undone too, so that a retry fails the same way
+    auto seen_before = seen;
+    try {
+        _load_short_sectors();
+    } catch (...) {
+        // leave nothing half-built behind for a later call to pick up
+        SSCS = stream_view_t();
+        SSAT.clear();
+        seen = std::move(seen_before);
+        throw;
+    }
+    sscs_loaded = true;
+    return SSCS;
+}
+
+void CompDoc::_load_short_sectors()
+{
     //
     // === get the SSCS ===
     //
-    auto sscs_dir = this->dirlist[0];
-    assert(sscs_dir->etype == 5); // root entry
-    if (sscs_dir->first_sid < 0 or sscs_dir->tot_size == 0) {
+    const auto sscs_first_sid = dir.first_sid[0];
+    const auto sscs_size = dir.tot_size[0];
+    if (sscs_first_sid < 0 or sscs_size == 0) {
         // Problem reported by Frank Hoffsuemmer: some software was
         // writing -1 instead of -2 (EOCSID) for the first_SID
         // when the SCCS was empty. Not having EOCSID caused assertion
         // failure in _get_stream.
         // Solution: avoid calling _get_stream in any case when the
         // SCSS appears to be empty.
-        SSCS = new data_t();
+        SSCS = stream_view_t();
     } else {
-        SSCS = &_get_stream(mem, 512, SAT, sec_size, sscs_dir->first_sid, sscs_dir->tot_size, "SSCS", 4);
+        SSCS = _get_stream(stream_view_t(source), sec_size, SAT, sec_size, sscs_first_sid, sscs_size, "SSCS", 4);
     }
     // if DEBUG: print >> logfile, "SSCS", repr(self.SSCS)
 
     //
     // === build the SSAT ===
     //
-    if (SSAT_tot_secs > 0 and sscs_dir->tot_size == 0) {
-        logfile << "WARNING *** OLE2 inconsistency: SSCS size is 0 but SSAT size is non-zero" << std::endl;
-    }
-    if (sscs_dir->tot_size > 0) {
+    if (sscs_size > 0) {
+        int nent = sec_size / 4; // number of SID entries in a sector
         int sid = SSAT_first_sec_sid;
         int nsecs = SSAT_tot_secs;
+        SSAT.reserve(static_cast<size_t>(std::max(nsecs, 0)) * nent);
         while (sid >= 0 and nsecs > 0) {
-            if (seen[sid]) {
-                throw CompDocError(std::format("SSAT corruption: seen[%d] == %d\n", sid, seen[sid]));
-            }
-            seen[sid] = 5;
+            _claim_sector(sid, 5, "SSAT");
             nsecs -= 1;
-            int start_pos = 512 + sid * sec_size;
-            auto news = mem.slice(start_pos, start_pos + sec_size).unpack_vec<int>(nent);
-            SSAT.insert(SSAT.end(), news.begin(), news.end());
+            _read_sids(_sector_offset(sid), nent, SSAT);
+            if (static_cast<size_t>(sid) >= SAT.size()) {
+                throw CompDocError(std::format("SSAT: sector allocation table invalid entry ({})", sid));
+            }
             sid = SAT[sid];
         }
         if (debug) {
@@ -305,22 +372,70 @@ CompDoc::CompDoc(const data_t& mem, std::ostream& logfile, int debug, bool ignor
     }
 }
 
-data_t& CompDoc::_get_stream(const data_t& mem, int base, std::vector<int>& sat, int sec_size, int start_sid, int size, std::string name, int seen_id)
+void CompDoc::_advise(access_hint_t hint, uint64_t offset, uint64_t length) const
+{
+    source->advise(hint, offset, length);
+}
+
+uint64_t CompDoc::_sector_offset(int sid) const
+{
+    // sector -1 is the header
+    return (static_cast<uint64_t>(sid) + 1) * sec_size;
+}
+
+void CompDoc::_read_sids(uint64_t offset, int count, std::pmr::vector<int>& sids) const
+{
+    // Append a sector's worth of SIDs to the MSAT, SAT or SSAT
+    size_t old_size = sids.size();
+    sids.resize(old_size + count);
+    size_t nbytes = count * sizeof(int);
+    if (source->read(offset, nbytes, reinterpret_cast<std::byte*>(sids.data() + old_size)) != nbytes) {
+        throw CompDocError(std::format("sector at offset %d is truncated", offset));
+    }
+}
+
+void CompDoc::_claim_sector(int sid, int seen_id, const std::string& name)
+{
+    // Record which structure owns each sector so that a sector reached
+    // twice -- a loop, or two chains sharing it -- is reported
+    if (validation == validation_t::trusted) {
+        return;
+    }
+    if (sid < 0 or static_cast<size_t>(sid) >= seen.size()) {
+        throw CompDocError(std::format("{} corruption: sector {} is past the end of the file", name, sid));
+    }
+    if (seen[sid]) {
+        throw CompDocError(std::format("%s corruption: seen[%d] == %d", name, sid, seen[sid]));
+    }
+    seen[sid] = seen_id;
+}
+
+stream_view_t CompDoc::_get_stream(const stream_view_t& container, uint64_t base, std::pmr::vector<int>& sat, int sec_size, int start_sid, int64_t size, std::string name, int seen_id)
 {
     // print >> self.logfile, "_get_stream", base, sec_size, start_sid, size
-    data_t* sectors = new data_t();
+    // Sectors are addressed within container; contiguous ones are merged
+    // into a single extent and nothing is copied.
+    std::vector<extent_t> sectors;
+    auto add_sector = [&](uint64_t start_pos, uint64_t length) {
+        if (!sectors.empty() and sectors.back().offset + sectors.back().length == start_pos) {
+            sectors.back().length += length;
+        } else {
+            sectors.push_back({ start_pos, length });
+        }
+    };
     int s = start_sid;
+    size_t nsecs = 0; // a chain longer than the table must revisit a sector
     if (size == -1) {
         // nothing to check agains
         while (s >= 0) {
+            if (++nsecs > sat.size()) {
+                throw CompDocError(std::format("OLE2 stream {}: sector chain loops", name));
+            }
             if (seen_id != -1) {
-                if (seen[s]) {
-                    throw CompDocError(std::format("%s corruption: seen[%d] == %d", name, s, seen[s]));
-                }
-                seen[s] = seen_id;
+                _claim_sector(s, seen_id, name);
             }
-            int start_pos = base + s * sec_size;
-            sectors->append(mem.slice(start_pos, start_pos + sec_size));
+            uint64_t start_pos = base + static_cast<uint64_t>(s) * sec_size;
+            add_sector(start_pos, sec_size);
             if (s < sat.size()) {
                 s = sat[s];
             } else {
@@ -329,21 +444,21 @@ data_t& CompDoc::_get_stream(const data_t& mem, int base, std::vector<int>& sat,
         }
         assert(s == EOCSID);
     } else {
-        int todo = size;
+        uint64_t todo = size;
         while (s >= 0) {
+            if (++nsecs > sat.size()) {
+                throw CompDocError(std::format("OLE2 stream {}: sector chain loops", name));
+            }
             if (seen_id != -1) {
-                if (seen[s]) {
-                    throw CompDocError(std::format("%s corruption: seen[%d] == %d", name, s, seen[s]));
-                }
-                seen[s] = seen_id;
+                _claim_sector(s, seen_id, name);
             }
-            int start_pos = base + s * sec_size;
-            int grab = sec_size;
+            uint64_t start_pos = base + static_cast<uint64_t>(s) * sec_size;
+            uint64_t grab = sec_size;
             if (grab > todo) {
                 grab = todo;
             }
             todo -= grab;
-            sectors->append(mem.slice(start_pos, start_pos + grab));
+            add_sector(start_pos, grab);
             if (s < sat.size()) {
                 s = sat[s];
             } else {
@@ -357,11 +472,11 @@ data_t& CompDoc::_get_stream(const data_t& mem, int base, std::vector<int>& sat,
         }
     }
 
-    return *sectors;
+    return container.substream(sectors);
 }
 
-std::tuple<const data_t*, int, int> CompDoc::_locate_stream(const data_t& mem, int base, std::vector<int>& sat,
-    int sec_size, int start_sid, int expected_stream_size, const std::string& qname, int seen_id)
+stream_view_t CompDoc::_locate_stream(uint64_t base, std::pmr::vector<int>& sat,
+    int sec_size, int start_sid, uint64_t expected_stream_size, const std::string& qname, int seen_id)
 {
     // print >> self.logfile, "_locate_stream", base, sec_size, start_sid, expected_stream_size
     int s = start_sid;
@@ -369,21 +484,28 @@ std::tuple<const data_t*, int, int> CompDoc::_locate_stream(const data_t& mem, i
         throw CompDocError(std::format("_locate_stream: start_sid (%d) is -ve", start_sid));
     }
     int p = -99; // dummy previous SID
-    int start_pos = -9999;
-    int end_pos = -8888;
-    std::vector<std::pair<int, int>> slices;
-    size_t tot_found = 0;
-    size_t found_limit = (expected_stream_size + sec_size - 1) / sec_size;
+    uint64_t start_pos = 0;
+    uint64_t end_pos = 0;
+    std::vector<std::pair<uint64_t, uint64_t>> slices;
+    uint64_t tot_found = 0;
+    uint64_t found_limit = (expected_stream_size + sec_size - 1) / sec_size;
 
     while (s >= 0) {
-        if (seen[s]) {
-            if (!ignore_workbook_corruption) {
+        if (s >= sat.size()) {
+            throw CompDocError(std::format("OLE2 stream %s: sector allocation table invalid entry (%d)", qname, s));
+        }
+        // In trusted mode the found_limit check below is what stops a loop
+        if (validation == validation_t::strict) {
+            if (static_cast<size_t>(s) >= seen.size()) {
+                throw CompDocError(std::format("{} corruption: sector {} is past the end of the file", qname, s));
+            }
+            if (seen[s] and !ignore_workbook_corruption) {
                 logfile << std::format("_locate_stream(%s): seen\n", qname);
                 dump_list(seen, 20, logfile);
                 throw CompDocError(std::format("%s corruption: seen[%d] == %d", qname, s, seen[s]));
             }
+            seen[s] = seen_id;
         }
-        seen[s] = seen_id;
         tot_found += 1;
         if (tot_found > found_limit) {
             // Note: expected size rounded up higher sector
@@ -399,7 +521,7 @@ std::tuple<const data_t*, int, int> CompDoc::_locate_stream(const data_t& mem, i
                 // not first time
                 slices.push_back({ start_pos, end_pos });
             }
-            start_pos = base + s * sec_size;
+            start_pos = base + static_cast<uint64_t>(s) * sec_size;
             end_pos = start_pos + sec_size;
         }
         p = s;
@@ -408,135 +530,196 @@ std::tuple<const data_t*, int, int> CompDoc::_locate_stream(const data_t& mem, i
     assert(s == EOCSID);
     assert(tot_found == found_limit);
     // print >> self.logfile, "_locate_stream(%s): seen" % qname; dump_list(self.seen, 20, self.logfile)
-    if (slices.empty()) {
-        // The stream is contiguous ... just what we like!
-        return { &mem, start_pos, expected_stream_size };
-    }
     slices.push_back({ start_pos, end_pos });
     // print >> self.logfile, "+++>>> %d fragments" % len(slices)
 
-    data_t* data = new data_t();
+    // A contiguous stream is just what we like, but fragments are no
+    // longer glued together: the view reads across them in place.
+    std::vector<extent_t> extents;
+    uint64_t todo = expected_stream_size;
     for (const auto& [start_pos, end_pos] : slices) {
-        data->append(mem.slice(start_pos, end_pos));
+        uint64_t grab = std::min(end_pos - start_pos, todo);
+        extents.push_back({ start_pos, grab });
+        _advise(access_hint_t::sequential, start_pos, grab);
+        _advise(access_hint_t::willneed, start_pos, grab);
+        todo -= grab;
     }
-    return { data, 0, expected_stream_size };
+    return { source, extents };
 }
 
-bool ichar_equals(char a, char b)
+// Case-fold a stream name for lookup (ASCII only)
+static std::string fold_name(std::string_view name)
 {
-    return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+    std::string result(name);
+    for (auto& c : result) {
+        c = std::tolower(static_cast<unsigned char>(c));
+    }
+    return result;
 }
 
-// Case-insensitive string equality check
-bool iequals(std::string_view lhs, std::string_view rhs)
+void CompDoc::_build_family_tree()
 {
-    return std::ranges::equal(lhs, rhs, ichar_equals);
+    // Each storage's children form a red-black tree threaded through the
+    // left/right DIDs; flatten it in order into dir.kids. Walked with
+    // explicit stacks, and every DID is taken at most once, so neither a
+    // degenerate tree nor a cycle in a hostile file can blow the stack.
+    std::vector<bool> visited(dir.size(), false);
+    std::vector<int32_t> storages = { 0 }, path;
+    visited[0] = true;
+    for (size_t i = 0; i < storages.size(); i++) {
+        const int32_t parent_did = storages[i];
+        dir.kids_first[parent_did] = static_cast<uint32_t>(dir.kids.size());
+
+        int32_t child_did = dir.root_did[parent_did];
+        while (child_did >= 0 or !path.empty()) {
+            while (child_did >= 0) {
+                if (static_cast<size_t>(child_did) >= dir.size()) {
+                    throw CompDocError(std::format("Directory corruption: DID {} out of range", child_did));
+                }
+                if (visited[child_did]) {
+                    break;
+                }
+                visited[child_did] = true;
+                path.push_back(child_did);
+                child_did = dir.left_did[child_did];
+            }
+            if (path.empty()) {
+                break;
+            }
+            child_did = path.back();
+            path.pop_back();
+
+            dir.kids.push_back(child_did);
+            dir.parent[child_did] = parent_did;
+            if (dir.etype[child_did] == 1) { // storage
+                storages.push_back(child_did);
+            }
+            child_did = dir.right_did[child_did];
+        }
+        dir.kids_count[parent_did] = static_cast<uint32_t>(dir.kids.size()) - dir.kids_first[parent_did];
+    }
 }
 
-std::vector<std::string> split(const std::string& input, char delimiter)
+void CompDoc::_build_dir_index()
 {
-    std::vector<std::string> result;
-    std::istringstream ss(input);
-    std::string token;
-
-    while (std::getline(ss, token, delimiter)) {
-        result.push_back(token);
+    // Folded "storage/.../name" path of every entry below the root, built
+    // once so that lookups don't rescan the children of each storage.
+    std::vector<std::pair<int, std::string>> todo = { { 0, "" } };
+    while (!todo.empty()) {
+        auto [storage_did, prefix] = std::move(todo.back());
+        todo.pop_back();
+
+        for (const auto child : dir.children(storage_did)) {
+            auto path = prefix + fold_name(dir.name(child));
+            // first match wins, as it did when searching the children in order
+            dir_index.emplace(path, child);
+            if (dir.etype[child] == 1) {
+                todo.push_back({ child, path + "/" });
+            }
+        }
     }
-
-    return result;
 }
 
-DirNode* CompDoc::_dir_search(const std::vector<std::string>& path, int storage_did)
+int CompDoc::_dir_search(const std::string& qname)
 {
-    // Return matching DirNode instance, or nullptr
-    std::string head = path[0];
-    std::vector<std::string> tail = { path.begin() + 1, path.end() };
-    for (const auto& child : dirlist[storage_did]->children) {
-        if (iequals(dirlist[child]->name, head)) {
-            const auto& et = dirlist[child]->etype;
-            if (et == 2) {
-                return dirlist[child];
-            }
-            if (et == 1) {
-                if (tail.empty()) {
-                    throw CompDocError("Requested component is a 'storage'");
-                }
-                return _dir_search(tail, child);
+    // Return the matching DID, or -1. The path is walked one component at
+    // a time, so a stream ends the search even if more components follow
+    // ("Workbook/x" is the Workbook stream), as the recursive search did.
+    const std::string path = fold_name(qname);
+    size_t end = 0;
+    while (true) {
+        end = path.find('/', end);
+        auto it = dir_index.find(path.substr(0, end));
+        if (it == dir_index.end()) {
+            return -1;
+        }
+
+        const int did = it->second;
+        if (dir.etype[did] == 2) {
+            return did;
+        }
+        if (dir.etype[did] == 1) {
+            if (end == std::string::npos) {
+                throw CompDocError("Requested component is a 'storage'");
             }
-            dirlist[child]->dump(1);
-            throw CompDocError("Requested stream is not a 'user stream'");
+            end++;
+            continue;
         }
+        dir.dump(did, logfile, 1);
+        throw CompDocError("Requested stream is not a 'user stream'");
     }
-
-    return nullptr;
 }
 
 /**
     Interrogate the compound document's directory; return the stream as a
-    string if found, otherwise return ``None``.
+    contiguous buffer if found, otherwise return ``std::nullopt``.
+
+    The bytes are allocated from the document's arena and stay valid until
+    the CompDoc is destroyed; there is nothing to free.
 
     :param qname:
-        Name of the desired stream e.g. ``'Workbook'``.
+        Name of the desired stream e.g. ``'Workbook'``, or a path through
+        storages separated by ``'/'``; matched case-insensitively. A path
+        that goes on past a stream resolves to that stream.
         Should be in Unicode or convertible thereto.
 */
-data_t* CompDoc::get_named_stream(const std::string& qname)
+std::optional<data_view_t> CompDoc::get_named_stream(const std::string& qname)
 {
-    const auto d = _dir_search(split(qname, '/'));
-    if (d == nullptr) {
-        return nullptr;
-    }
-    if (d->tot_size >= min_size_std_stream) {
-        return &_get_stream(mem, 512, SAT, sec_size, d->first_sid, d->tot_size, qname, d->did + 6);
-    } else {
-        return &_get_stream(*SSCS, 0, SSAT, short_sec_size, d->first_sid, d->tot_size, qname + " (from SSCS)");
-    }
+    const auto did = _dir_search(qname);
+    if (did < 0) {
+        return std::nullopt;
+    }
+    auto stream = dir.tot_size[did] >= min_size_std_stream
+        ? _get_stream(stream_view_t(source), sec_size, SAT, sec_size, dir.first_sid[did], dir.tot_size[did], qname, did + 6)
+        : _get_stream(_short_sectors(), 0, SSAT, short_sec_size, dir.first_sid[did], dir.tot_size[did], qname + " (from SSCS)");
+    if (stream.empty()) {
+        return data_view_t();
+    }
+    auto buffer = static_cast<std::byte*>(arena.allocate(stream.size(), alignof(std::max_align_t)));
+    stream.read(buffer, stream.size());
+    return data_view_t(buffer, stream.size());
 }
 
 /**
     Interrogate the compound document's directory.
 
-    If the named stream is not found, ``(None, 0, 0)`` will be returned.
-
-    If the named stream is found and is contiguous within the original
-    byte sequence (``mem``) used when the document was opened,
-    then ``(mem, offset_to_start_of_stream, length_of_stream)`` is returned.
+    If the named stream is not found, ``std::nullopt`` will be returned.
 
-    Otherwise a new string is built from the fragments and
-    ``(new_string, 0, length_of_stream)`` is returned.
+    Otherwise a stream_view_t is returned holding the stream's extents
+    within the byte source (``mem``, the mapped file, ...) the document was
+    opened from. Nothing is copied, whether the stream
+    is contiguous or fragmented; use stream_view_t::contiguous_view() or
+    the cursor to read it.
 
     :param qname:
         Name of the desired stream e.g. ``'Workbook'``.
         Should be in Unicode or convertible thereto.
 */
-std::tuple<const data_t*, int, int> CompDoc::locate_named_stream(const std::string& qname)
+std::optional<stream_view_t> CompDoc::locate_named_stream(const std::string& qname)
 {
-    const auto d = _dir_search(split(qname, '/'));
-    if (d == nullptr) {
-        return { nullptr, 0, 0 };
+    const auto did = _dir_search(qname);
+    if (did < 0) {
+        return std::nullopt;
     }
-    if (d->tot_size > mem_data_len) {
-        throw CompDocError(std::format("%s stream length (%d bytes) > file data size (%d bytes)", qname, d->tot_size, mem_data_len));
+    if (dir.tot_size[did] > mem_data_len) {
+        throw CompDocError(std::format("%s stream length (%d bytes) > file data size (%d bytes)", qname, dir.tot_size[did], mem_data_len));
     }
-    if (d->tot_size >= min_size_std_stream) {
-        auto result = _locate_stream(mem, 512, SAT, sec_size, d->first_sid, d->tot_size, qname, d->did + 6);
+    if (dir.tot_size[did] >= min_size_std_stream) {
+        auto result = _locate_stream(sec_size, SAT, sec_size, dir.first_sid[did], dir.tot_size[did], qname, did + 6);
         if (debug) {
             logfile << "\nseen\n";
             dump_list(seen, 20, logfile);
         }
         return result;
     } else {
-        return {
-            &_get_stream(
-                *SSCS, 0, SSAT, short_sec_size, d->first_sid,
-                d->tot_size, qname + " (from SSCS)"),
-            0,
-            d->tot_size
-        };
+        return _get_stream(
+            _short_sectors(), 0, SSAT, short_sec_size, dir.first_sid[did],
+            dir.tot_size[did], qname + " (from SSCS)");
     }
 }
 
 template <typename T>
-void dump_list(std::vector<T>& list, int stride, std::ostream& f)
+void dump_list(const std::pmr::vector<T>& list, int stride, std::ostream& f)
 {
     auto _dump_line = [&](int dpos, int equal = 0) {
         f << std::format("%5d%s ", dpos, " ="[equal]);
@@ -1,57 +1,142 @@
 #include "excelr8/data.hpp"
+#include <algorithm>
 #include <cstddef>
 #include <cstring>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 namespace excelr8 {
 
-data_t::data_t() { }
+data_view_t::data_view_t(const std::byte* ptr, size_t size)
+    : _ptr(ptr)
+    , _size(size)
+{
+}
 
-data_t::data_t(std::vector<std::byte>& buffer)
-    : _data(buffer)
+data_view_t::data_view_t(const data_t& data)
+    : _ptr(data.data())
+    , _size(data.size())
 {
 }
 
-data_t::data_t(const std::string& buffer)
+void data_view_t::_check(size_t offset, size_t count) const
 {
-    _data = std::vector<std::byte>(buffer.size());
-    std::memcpy(_data.data(), buffer.data(), buffer.size());
+    if (offset > _size or count > _size - offset) {
+        throw std::out_of_range(std::to_string(count) + " bytes at offset " + std::to_string(offset)
+            + " exceed view of " + std::to_string(_size) + " bytes");
+    }
 }
 
-data_t data_t::slice(int start, int end) const
+data_view_t data_view_t::slice(size_t start, size_t end) const
 {
-    std::vector<std::byte> vec = { _data.begin() + start, _data.begin() + end + 1 };
-    return { vec };
+    end = std::min(end, _size);
+    start = std::min(start, end);
+    return { _ptr + start, end - start };
 }
 
 template <typename T>
-T data_t::_unpack(size_t& offset) const
+T data_view_t::_unpack(size_t& offset) const
 {
     T result;
-    const char* buffer = (const char*)(_data.data());
-    std::memcpy(&result, buffer + offset, sizeof(T));
+    std::memcpy(&result, _ptr + offset, sizeof(T));
     offset += sizeof(T);
     return result;
 }
 
 template <typename... Ts>
-std::tuple<Ts...> data_t::unpack(size_t offset) const
+std::tuple<Ts...> data_view_t::unpack(size_t offset) const
 {
-    return std::make_tuple(_unpack<Ts>(offset)...);
+    _check(offset, (sizeof(Ts) + ...));
+    // braced init guarantees left-to-right evaluation of the pack
+    return std::tuple<Ts...> { _unpack<Ts>(offset)... };
 }
 
 template <typename T>
-std::vector<T> data_t::unpack_vec(size_t count) const
+std::vector<T> data_view_t::unpack_vec(size_t count, size_t offset) const
 {
-    size_t offset = 0;
+    _check(offset, count * sizeof(T));
     std::vector<T> result(count);
-    for (size_t i = 0; i < count; i++) {
-        T item = _unpack<T>(offset);
-        result.push_back(item);
-    }
+    std::memcpy(result.data(), _ptr + offset, count * sizeof(T));
     return result;
 }
 
+const std::byte* data_view_t::data() const
+{
+    return _ptr;
+}
+
+size_t data_view_t::size() const
+{
+    return _size;
+}
+
+bool data_view_t::empty() const
+{
+    return _size == 0;
+}
+
+const std::byte* data_view_t::begin() const
+{
+    return _ptr;
+}
+
+const std::byte* data_view_t::end() const
+{
+    return _ptr + _size;
+}
+
+std::byte data_view_t::operator[](size_t index) const
+{
+    _check(index, 1);
+    return _ptr[index];
+}
+
+bool data_view_t::operator==(const data_view_t& other) const
+{
+    return _size == other._size and (_size == 0 or std::memcmp(_ptr, other._ptr, _size) == 0);
+}
+
+bool data_view_t::operator!=(const data_view_t& other) const
+{
+    return not(*this == other);
+}
+
+std::string data_view_t::to_string() const
+{
+    return std::string(reinterpret_cast<const char*>(_ptr), _size);
+}
+
+data_t::data_t() { }
+
+data_t::data_t(std::vector<std::byte>& buffer)
+    : _data(buffer)
+{
+}
+
+data_t::data_t(std::vector<std::byte>&& buffer)
+    : _data(std::move(buffer))
+{
+}
+
+data_t::data_t(const std::string& buffer)
+{
+    _data = std::vector<std::byte>(buffer.size());
+    std::memcpy(_data.data(), buffer.data(), buffer.size());
+}
+
+data_t::data_t(data_view_t view)
+    : _data(view.begin(), view.end())
+{
+}
+
+data_view_t data_t::slice(size_t start, size_t end) const
+{
+    return data_view_t(*this).slice(start, end);
+}
+
 const std::byte* data_t::data() const
 {
     return _data.data();
@@ -82,13 +167,13 @@ bool data_t::operator!=(const data_t& other) const
     return _data != other._data;
 }
 
-inline data_t& data_t::operator+=(const data_t& other)
+data_t& data_t::operator+=(data_view_t other)
 {
-    _data.insert(_data.end(), other._data.begin(), other._data.end());
+    _data.insert(_data.end(), other.begin(), other.end());
     return *this;
 }
 
-data_t& data_t::append(const data_t& other)
+data_t& data_t::append(data_view_t other)
 {
     *this += other;
     return *this;
@@ -99,22 +184,28 @@ std::string data_t::to_string() const
     return std::string(reinterpret_cast<const char*>(_data.data()), _data.size());
 }
 
-template pytype_B data_t::_unpack<pytype_B>(size_t&) const;
-template pytype_H data_t::_unpack<pytype_H>(size_t&) const;
-template pytype_i data_t::_unpack<pytype_i>(size_t&) const;
-
-template std::tuple<pytype_B> data_t::unpack<pytype_B>(size_t) const;
-template std::tuple<pytype_H> data_t::unpack<pytype_H>(size_t) const;
-template std::tuple<pytype_i> data_t::unpack<pytype_i>(size_t) const;
-template std::tuple<pytype_H, pytype_H, pytype_B, pytype_B> data_t::unpack<pytype_H, pytype_H, pytype_B, pytype_B>(size_t) const;
-template std::tuple<pytype_H, pytype_H, pytype_H, pytype_H> data_t::unpack<pytype_H, pytype_H, pytype_H, pytype_H>(size_t) const;
-template std::tuple<pytype_H, pytype_H> data_t::unpack<pytype_H, pytype_H>(size_t) const;
-template std::tuple<pytype_i, pytype_i> data_t::unpack<pytype_i, pytype_i>(size_t) const;
-template std::tuple<pytype_H, pytype_B, pytype_B, pytype_i, pytype_i, pytype_i> data_t::unpack<pytype_H, pytype_B, pytype_B, pytype_i, pytype_i, pytype_i>(size_t) const;
-template std::tuple<pytype_I, pytype_I, pytype_I, pytype_I> data_t::unpack<pytype_I, pytype_I, pytype_I, pytype_I>(size_t) const;
-template std::tuple<pytype_H, pytype_H, pytype_H, pytype_H, pytype_H, pytype_B, pytype_B, pytype_B> data_t::unpack<pytype_H, pytype_H, pytype_H, pytype_H, pytype_H, pytype_B, pytype_B, pytype_B>(size_t) const;
-template std::tuple<pytype_H, pytype_H, pytype_H> data_t::unpack<pytype_H, pytype_H, pytype_H>(size_t) const;
-
-template std::vector<pytype_i> data_t::unpack_vec<pytype_i>(size_t) const;
+template std::tuple<pytype_B> data_view_t::unpack<pytype_B>(size_t) const;
+template std::tuple<pytype_H> data_view_t::unpack<pytype_H>(size_t) const;
+template std::tuple<pytype_i> data_view_t::unpack<pytype_i>(size_t) const;
+template std::tuple<pytype_d> data_view_t::unpack<pytype_d>(size_t) const;
+template std::tuple<pytype_I> data_view_t::unpack<pytype_I>(size_t) const;
+template std::tuple<pytype_H, pytype_H, pytype_B, pytype_B> data_view_t::unpack<pytype_H, pytype_H, pytype_B, pytype_B>(size_t) const;
+template std::tuple<pytype_H, pytype_H, pytype_H, pytype_H> data_view_t::unpack<pytype_H, pytype_H, pytype_H, pytype_H>(size_t) const;
+template std::tuple<pytype_H, pytype_H> data_view_t::unpack<pytype_H, pytype_H>(size_t) const;
+template std::tuple<pytype_i, pytype_i> data_view_t::unpack<pytype_i, pytype_i>(size_t) const;
+template std::tuple<pytype_H, pytype_B, pytype_B, pytype_i, pytype_i, pytype_i> data_view_t::unpack<pytype_H, pytype_B, pytype_B, pytype_i, pytype_i, pytype_i>(size_t) const;
+template std::tuple<pytype_I, pytype_I, pytype_I, pytype_I> data_view_t::unpack<pytype_I, pytype_I, pytype_I, pytype_I>(size_t) const;
+template std::tuple<pytype_H, pytype_H, pytype_H, pytype_H, pytype_H, pytype_B, pytype_B, pytype_B> data_view_t::unpack<pytype_H, pytype_H, pytype_H, pytype_H, pytype_H, pytype_B, pytype_B, pytype_B>(size_t) const;
+template std::tuple<pytype_H, pytype_H, pytype_H> data_view_t::unpack<pytype_H, pytype_H, pytype_H>(size_t) const;
+template std::tuple<pytype_i, pytype_I, pytype_I> data_view_t::unpack<pytype_i, pytype_I, pytype_I>(size_t) const;
+template std::tuple<pytype_H, pytype_B> data_view_t::unpack<pytype_H, pytype_B>(size_t) const;
+template std::tuple<pytype_I, pytype_H> data_view_t::unpack<pytype_I, pytype_H>(size_t) const;
+template std::tuple<pytype_H, pytype_H, pytype_H, pytype_d> data_view_t::unpack<pytype_H, pytype_H, pytype_H, pytype_d>(size_t) const;
+template std::tuple<pytype_H, pytype_H, pytype_H, pytype_i> data_view_t::unpack<pytype_H, pytype_H, pytype_H, pytype_i>(size_t) const;
+template std::tuple<pytype_H, pytype_H, pytype_H, pytype_B, pytype_B> data_view_t::unpack<pytype_H, pytype_H, pytype_H, pytype_B, pytype_B>(size_t) const;
+template std::tuple<pytype_i, pytype_B, pytype_B> data_view_t::unpack<pytype_i, pytype_B, pytype_B>(size_t) const;
+template std::tuple<pytype_I, pytype_I, pytype_H, pytype_H> data_view_t::unpack<pytype_I, pytype_I, pytype_H, pytype_H>(size_t) const;
+
+template std::vector<pytype_i> data_view_t::unpack_vec<pytype_i>(size_t, size_t) const;
 
 }
\ No newline at end of file
@@ -1,5 +1,64 @@
+#include "excelr8/excelr8.hpp"
+#include "excelr8/mmap.hpp"
+#include <chrono>
 #include <iostream>
 
 namespace excelr8 {
 
+dllexport std::unique_ptr<book::Book> open_workbook(std::shared_ptr<const byte_source_t> source, const open_options_t& options)
+{
+    using clock = std::chrono::steady_clock;
+    auto t0 = clock::now();
+
+    auto bk = std::make_unique<book::Book>(options.memory_resource ? options.memory_resource : std::pmr::get_default_resource());
+    bk->verbosity = options.verbosity;
+    bk->formatting_info = options.formatting_info;
+    bk->on_demand = options.on_demand;
+    bk->lazy_sst = options.lazy_sst;
+    bk->nthreads = options.nthreads;
+    bk->projection = options.projection;
+    bk->sheet_subset = options.sheets;
+    bk->encoding_override = options.encoding_override;
+
+    bk->biff2_8_load(std::move(source), options.ignore_workbook_corruption);
+    auto t1 = clock::now();
+    bk->load_time_stage_1 = std::chrono::duration<float>(t1 - t0).count();
+
+    bk->parse_globals();
+    if (!bk->on_demand) {
+        bk->get_sheets();
+    }
+    bk->load_time_stage_2 = std::chrono::duration<float>(clock::now() - t1).count();
+    return bk;
+}
+
+dllexport std::unique_ptr<book::Book> open_workbook(const std::filesystem::path& filename, const open_options_t& options)
+{
+    return open_workbook(std::make_shared<const mapped_file_t>(filename), options);
+}
+
+dllexport std::unique_ptr<book::Book> open_workbook(data_view_t file_contents, const open_options_t& options)
+{
+    return open_workbook(std::make_shared<const memory_source_t>(file_contents), options);
+}
+
+dllexport book::workbook_info_t open_workbook_info(std::shared_ptr<const byte_source_t> source, const open_options_t& options)
+{
+    book::Book bk(options.memory_resource ? options.memory_resource : std::pmr::get_default_resource());
+    bk.verbosity = options.verbosity;
+    bk.encoding_override = options.encoding_override;
+    bk.biff2_8_load(std::move(source), options.ignore_workbook_corruption);
+    return bk.scan_info();
+}
+
+dllexport book::workbook_info_t open_workbook_info(const std::filesystem::path& filename, const open_options_t& options)
+{
+    return open_workbook_info(std::make_shared<const mapped_file_t>(filename), options);
+}
+
+dllexport book::workbook_info_t open_workbook_info(data_view_t file_contents, const open_options_t& options)
+{
+    return open_workbook_info(std::make_shared<const memory_source_t>(file_contents), options);
+}
+
 }
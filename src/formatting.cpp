@@ -4,6 +4,7 @@
 #include "excelr8/data.hpp"
 #include <format>
 #include <iostream>
+#include <memory_resource>
 #include <unordered_map>
 
 namespace excelr8::book {
@@ -22,16 +23,18 @@ void initialize_color_map(book::Book& book)
         return;
     }
 
+    std::pmr::polymorphic_allocator<color_t> alloc(&book.arena);
+
     // Add the 8 invariant colors
     for (int i = 0; i < 8; i++) {
-        book.color_map[i] = new color_t(excel_default_palette_b8[i]);
+        book.color_map[i] = alloc.new_object<color_t>(excel_default_palette_b8[i]);
     }
 
     // Add the default palette depending on the version
     auto& dpal = default_palette.at(book.biff_version);
     size_t ndpal = dpal.size();
     for (int i = 0; i < ndpal; i++) {
-        book.color_map[i + 8] = new color_t(dpal[i]);
+        book.color_map[i + 8] = alloc.new_object<color_t>(dpal[i]);
     }
 
     // Add the specials -- nullptr means the RGB value is not known
@@ -87,7 +90,7 @@ uint16_t nearest_color_index(std::unordered_map<uint16_t, color_t*>& color_map,
     return best_colorx;
 }
 
-void handle_efont(book::Book& book, const data_t& data)
+void handle_efont(book::Book& book, data_view_t data)
 {
     if (!book.formatting_info) {
         return;
@@ -96,7 +99,7 @@ void handle_efont(book::Book& book, const data_t& data)
     last_font.color_index = std::get<0>(data.unpack<pytype_H>());
 }
 
-void handle_font(book::Book& book, const data_t& data)
+void handle_font(book::Book& book, data_view_t data)
 {
     if (!book.formatting_info) {
         return;
@@ -124,7 +127,7 @@ void handle_font(book::Book& book, const data_t& data)
     if (bv >= 50) {
         pytype_H option_flags;
         std::tie(f.height, option_flags, f.color_index, f.weight, f.escapement, f.underline_type, f.family, f.character_set)
-            = data.slice(0, 13).unpack<pytype_H, pytype_H, pytype_H, pytype_H, pytype_H, pytype_B, pytype_B, pytype_B>();
+            = data.unpack<pytype_H, pytype_H, pytype_H, pytype_H, pytype_H, pytype_B, pytype_B, pytype_B>();
 
         f.bold = option_flags & 1;
         f.italic = (option_flags & 2) >> 1;
@@ -135,18 +138,18 @@ void handle_font(book::Book& book, const data_t& data)
         if (bv >= 80) {
             f.name = unpack_unicode(data, 14, 1);
         } else {
-            f.name = unpack_string(data, 14, book.encoding, 1);
+            f.name = unpack_string(data, 14, book.codec, 1);
         }
     } else if (bv >= 30) {
         uint16_t option_flags;
-        std::tie(f.height, option_flags, f.color_index) = data.slice(0, 6).unpack<pytype_H, pytype_H, pytype_H>();
+        std::tie(f.height, option_flags, f.color_index) = data.unpack<pytype_H, pytype_H, pytype_H>();
         f.bold = option_flags & 1;
         f.italic = (option_flags & 2) >> 1;
         f.underlined = (option_flags & 4) >> 2;
         f.struck_out = (option_flags & 8) >> 3;
         f.outline = (option_flags & 16) >> 4;
         f.shadow = (option_flags & 32) >> 5;
-        f.name = unpack_string(data, 6, book.encoding, 1);
+        f.name = unpack_string(data, 6, book.codec, 1);
 
         // Now cook up the remaining attributes ...
         f.weight = f.bold ? 700 : 400;
@@ -156,7 +159,7 @@ void handle_font(book::Book& book, const data_t& data)
         f.character_set = 1; // System default (0 means "ANSI Latin")
     } else { // BIFF2
         uint16_t option_flags;
-        std::tie(f.height, option_flags) = data.slice(0, 4).unpack<pytype_H, pytype_H>();
+        std::tie(f.height, option_flags) = data.unpack<pytype_H, pytype_H>();
         f.color_index = 0x7FFF; // "system window text color"
         f.bold = option_flags & 1;
         f.italic = (option_flags & 2) >> 1;
@@ -164,7 +167,7 @@ void handle_font(book::Book& book, const data_t& data)
         f.struck_out = (option_flags & 8) >> 3;
         f.outline = 0;
         f.shadow = 0;
-        f.name = unpack_string(data, 4, book.encoding, 1);
+        f.name = unpack_string(data, 4, book.codec, 1);
 
         // Now cook up the remaining attributes ...
         f.weight = f.bold ? 700 : 400;
@@ -0,0 +1,183 @@
+#include "excelr8/mmap.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+
+#if defined _WIN32 || defined __CYGWIN__
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace excelr8 {
+
+#if defined _WIN32 || defined __CYGWIN__
+
+mapped_file_t::mapped_file_t(const std::filesystem::path& filename)
+{
+    HANDLE file = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::system_error(GetLastError(), std::system_category(), filename.string());
+    }
+    _file = file;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        auto err = GetLastError();
+        _unmap();
+        throw std::system_error(err, std::system_category(), filename.string());
+    }
+    if (static_cast<uint64_t>(size.QuadPart) > SIZE_MAX) {
+        _unmap();
+        // can't map it into this address space; use a pread_source_t
+        throw std::system_error(ERROR_FILE_TOO_LARGE, std::system_category(), filename.string());
+    }
+    _size = size.QuadPart;
+    if (_size == 0) {
+        return; // nothing to map; view() is empty
+    }
+
+    _mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (_mapping != nullptr) {
+        _ptr = static_cast<const std::byte*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+    }
+    if (_ptr == nullptr) {
+        auto err = GetLastError();
+        _unmap();
+        throw std::system_error(err, std::system_category(), filename.string());
+    }
+}
+
+void mapped_file_t::_unmap()
+{
+    if (_ptr != nullptr) {
+        UnmapViewOfFile(_ptr);
+    }
+    if (_mapping != nullptr) {
+        CloseHandle(_mapping);
+    }
+    if (_file != nullptr) {
+        CloseHandle(_file);
+    }
+    _ptr = nullptr;
+    _mapping = _file = nullptr;
+}
+
+void mapped_file_t::advise(access_hint_t, uint64_t, uint64_t) const
+{
+    // no madvise equivalent worth the trouble
+}
+
+#else
+
+mapped_file_t::mapped_file_t(const std::filesystem::path& filename)
+{
+    int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), filename.string());
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        int err = errno;
+        ::close(fd);
+        throw std::system_error(err, std::generic_category(), filename.string());
+    }
+    if (static_cast<uint64_t>(st.st_size) > SIZE_MAX) {
+        ::close(fd);
+        // can't map it into this address space; use a pread_source_t
+        throw std::system_error(EFBIG, std::generic_category(), filename.string());
+    }
+    _size = st.st_size;
+    if (_size == 0) {
+        ::close(fd);
+        return; // mmap refuses empty ranges; view() is empty
+    }
+
+    void* ptr = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+    int err = errno;
+    ::close(fd); // the mapping keeps its own reference
+    if (ptr == MAP_FAILED) {
+        throw std::system_error(err, std::generic_category(), filename.string());
+    }
+    _ptr = static_cast<const std::byte*>(ptr);
+}
+
+void mapped_file_t::_unmap()
+{
+    if (_ptr != nullptr) {
+        ::munmap(const_cast<std::byte*>(_ptr), _size);
+    }
+    _ptr = nullptr;
+}
+
+void mapped_file_t::advise(access_hint_t hint, uint64_t offset, uint64_t length) const
+{
+    if (_ptr == nullptr or offset >= _size) {
+        return;
+    }
+    length = std::min<uint64_t>(length, _size - offset);
+
+    // madvise wants a page-aligned start address
+    static const size_t page_size = ::sysconf(_SC_PAGESIZE);
+    size_t aligned = offset - offset % page_size;
+    length += offset - aligned;
+
+    int advice = MADV_NORMAL;
+    switch (hint) {
+    case access_hint_t::normal:
+        advice = MADV_NORMAL;
+        break;
+    case access_hint_t::sequential:
+        advice = MADV_SEQUENTIAL;
+        break;
+    case access_hint_t::random:
+        advice = MADV_RANDOM;
+        break;
+    case access_hint_t::willneed:
+        advice = MADV_WILLNEED;
+        break;
+    }
+    ::madvise(const_cast<std::byte*>(_ptr) + aligned, length, advice);
+}
+
+#endif
+
+mapped_file_t::~mapped_file_t()
+{
+    _unmap();
+}
+
+data_view_t mapped_file_t::view() const
+{
+    return { _ptr, _size };
+}
+
+uint64_t mapped_file_t::size() const
+{
+    return _size;
+}
+
+size_t mapped_file_t::read(uint64_t offset, size_t count, std::byte* dst) const
+{
+    if (offset >= _size) {
+        return 0;
+    }
+    auto range = view().slice(offset, offset + std::min<uint64_t>(count, _size - offset));
+    if (!range.empty()) {
+        std::memcpy(dst, range.data(), range.size());
+    }
+    return range.size();
+}
+
+const std::byte* mapped_file_t::resident() const
+{
+    return _ptr;
+}
+
+}
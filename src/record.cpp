@@ -0,0 +1,171 @@
+#include "excelr8/record.hpp"
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace excelr8::biff {
+
+record_cursor_t::record_cursor_t(stream_view_t stream)
+    : _stream(std::move(stream))
+{
+    const auto& source = _stream.source();
+    if (_stream.contiguous() and source and source->resident() != nullptr) {
+        _mem = _stream.contiguous_view();
+        _in_place = true;
+    }
+}
+
+record_cursor_t::record_cursor_t(data_view_t mem)
+    : _mem(mem)
+    , _in_place(true)
+{
+}
+
+uint64_t record_cursor_t::size() const
+{
+    return _in_place ? _mem.size() : _stream.size();
+}
+
+uint64_t record_cursor_t::tell() const
+{
+    return _pos;
+}
+
+void record_cursor_t::seek(uint64_t pos)
+{
+    _pos = std::min(pos, size());
+}
+
+bool record_cursor_t::eof() const
+{
+    return size() - _pos < 4;
+}
+
+bool record_cursor_t::_header(uint64_t pos, uint16_t& opcode, uint16_t& length)
+{
+    if (pos > size() or size() - pos < 4) {
+        return false;
+    }
+    std::byte header[4];
+    if (_in_place) {
+        std::memcpy(header, _mem.data() + pos, 4);
+    } else {
+        _stream.seek(pos);
+        _stream.read(header, 4);
+    }
+    std::memcpy(&opcode, header, 2);
+    std::memcpy(&length, header + 2, 2);
+    return true;
+}
+
+data_view_t record_cursor_t::_payload(uint64_t pos, size_t length)
+{
+    if (_in_place) {
+        return { _mem.data() + pos, length };
+    }
+    _stream.seek(pos);
+    return _stream.next(length);
+}
+
+void record_cursor_t::_append(uint64_t pos, size_t length)
+{
+    size_t old_size = _joined.size();
+    _joined.resize(old_size + length);
+    if (_in_place) {
+        std::memcpy(_joined.data() + old_size, _mem.data() + pos, length);
+    } else {
+        _stream.seek(pos);
+        _stream.read(_joined.data() + old_size, length);
+    }
+}
+
+std::optional<uint16_t> record_cursor_t::peek_opcode()
+{
+    uint16_t opcode, length;
+    if (!_header(_pos, opcode, length)) {
+        return std::nullopt;
+    }
+    return opcode;
+}
+
+std::optional<record_t> record_cursor_t::next()
+{
+    uint16_t opcode, length;
+    if (!_header(_pos, opcode, length)) {
+        return std::nullopt;
+    }
+    uint64_t start = _pos + 4;
+    // a truncated last record gets whatever is left, as slicing would
+    size_t avail = std::min<uint64_t>(length, size() - start);
+    record_t rec { opcode, length, _payload(start, avail), _pos };
+    _pos = start + avail;
+    return rec;
+}
+
+std::optional<uint16_t> record_cursor_t::skip()
+{
+    uint16_t opcode, length;
+    if (!_header(_pos, opcode, length)) {
+        return std::nullopt;
+    }
+    _pos = std::min<uint64_t>(_pos + 4 + length, size());
+    return opcode;
+}
+
+std::optional<record_t> record_cursor_t::next_joined(uint16_t continue_opcode)
+{
+    _segments.assign(1, 0);
+    uint16_t opcode, length;
+    if (!_header(_pos, opcode, length)) {
+        return std::nullopt;
+    }
+    uint64_t offset = _pos;
+    uint64_t start = _pos + 4;
+    size_t avail = std::min<uint64_t>(length, size() - start);
+    uint64_t end = start + avail;
+
+    // Look ahead before taking the payload: on a non-resident stream the
+    // view would not survive reading the next header.
+    uint16_t next_opcode, next_length;
+    bool continued = _header(end, next_opcode, next_length) and next_opcode == continue_opcode;
+    if (!continued and _in_place) {
+        _pos = end;
+        return record_t { opcode, length, _payload(start, avail), offset };
+    }
+
+    // Otherwise the payload is kept in _joined, where next() leaves it alone
+    _joined.clear();
+    _append(start, avail);
+    size_t total = length;
+    while (_header(end, next_opcode, next_length) and next_opcode == continue_opcode) {
+        start = end + 4;
+        avail = std::min<uint64_t>(next_length, size() - start);
+        _segments.push_back(_joined.size());
+        _append(start, avail);
+        total += next_length;
+        end = start + avail;
+    }
+    _pos = end;
+    return record_t { opcode, total, data_view_t(_joined.data(), _joined.size()), offset };
+}
+
+const std::vector<size_t>& record_cursor_t::segments() const
+{
+    return _segments;
+}
+
+bool skip_substream(record_cursor_t& cursor)
+{
+    int depth = 1;
+    while (depth > 0) {
+        auto opcode = cursor.skip();
+        if (!opcode) {
+            return false;
+        }
+        auto cls = record_info(*opcode).cls;
+        depth += cls == record_class_t::bof ? 1 : cls == record_class_t::eof ? -1 : 0;
+    }
+    return true;
+}
+
+}
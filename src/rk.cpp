@@ -0,0 +1,179 @@
+#include "excelr8/rk.hpp"
+#include "excelr8/biff.hpp"
+#include "excelr8/util.hpp"
+#include <algorithm>
+#include <cstring>
+#include <format>
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+namespace excelr8::biff {
+
+static inline uint16_t load_u16(const std::byte* p)
+{
+    uint16_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t load_u32(const std::byte* p)
+{
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static void rk_run_scalar(const std::byte* src, size_t count, size_t stride, double* values, uint16_t* xf_indexes)
+{
+    for (size_t i = 0; i < count; i++, src += stride) {
+        xf_indexes[i] = load_u16(src);
+        values[i] = rk_to_double(load_u32(src + 2));
+    }
+}
+
+#if defined(__x86_64__) || defined(_M_X64)
+// Both forms are decoded for every lane and the flag bits pick one; the
+// division is a real division, as in rk_to_double(), so the results are
+// bit-identical to the scalar code.
+
+static void rk_run_sse2(const std::byte* src, size_t count, size_t stride, double* values, uint16_t* xf_indexes)
+{
+    const __m128i int_flag = _mm_set1_epi32(2);
+    const __m128i div_flag = _mm_set1_epi32(1);
+    const __m128i mantissa = _mm_set1_epi32(~3);
+    const __m128d hundred = _mm_set1_pd(100.0);
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        uint32_t rk[2];
+        for (size_t k = 0; k < 2; k++, src += stride) {
+            xf_indexes[i + k] = load_u16(src);
+            rk[k] = load_u32(src + 2);
+        }
+        __m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(rk));
+        __m128d as_int = _mm_cvtepi32_pd(_mm_srai_epi32(v, 2));
+        __m128d as_double = _mm_castsi128_pd(_mm_unpacklo_epi32(_mm_setzero_si128(), _mm_and_si128(v, mantissa)));
+        __m128i is_int = _mm_cmpeq_epi32(_mm_and_si128(v, int_flag), int_flag);
+        __m128d int_mask = _mm_castsi128_pd(_mm_unpacklo_epi32(is_int, is_int));
+        __m128d d = _mm_or_pd(_mm_and_pd(int_mask, as_int), _mm_andnot_pd(int_mask, as_double));
+        __m128i is_div = _mm_cmpeq_epi32(_mm_and_si128(v, div_flag), div_flag);
+        __m128d div_mask = _mm_castsi128_pd(_mm_unpacklo_epi32(is_div, is_div));
+        d = _mm_or_pd(_mm_and_pd(div_mask, _mm_div_pd(d, hundred)), _mm_andnot_pd(div_mask, d));
+        _mm_storeu_pd(values + i, d);
+    }
+    rk_run_scalar(src, count - i, stride, values + i, xf_indexes + i);
+}
+
+#if defined(__GNUC__)
+#define EXCELR8_HAVE_AVX2 1
+
+__attribute__((target("avx2"))) static void rk_run_avx2(const std::byte* src, size_t count, size_t stride, double* values, uint16_t* xf_indexes)
+{
+    const __m128i int_flag = _mm_set1_epi32(2);
+    const __m128i div_flag = _mm_set1_epi32(1);
+    const __m128i mantissa = _mm_set1_epi32(~3);
+    const __m256d hundred = _mm256_set1_pd(100.0);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        uint32_t rk[4];
+        for (size_t k = 0; k < 4; k++, src += stride) {
+            xf_indexes[i + k] = load_u16(src);
+            rk[k] = load_u32(src + 2);
+        }
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rk));
+        __m256d as_int = _mm256_cvtepi32_pd(_mm_srai_epi32(v, 2));
+        __m256d as_double = _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_cvtepu32_epi64(_mm_and_si128(v, mantissa)), 32));
+        __m256d int_mask = _mm256_castsi256_pd(_mm256_cvtepi32_epi64(_mm_cmpeq_epi32(_mm_and_si128(v, int_flag), int_flag)));
+        __m256d d = _mm256_blendv_pd(as_double, as_int, int_mask);
+        __m256d div_mask = _mm256_castsi256_pd(_mm256_cvtepi32_epi64(_mm_cmpeq_epi32(_mm_and_si128(v, div_flag), div_flag)));
+        d = _mm256_blendv_pd(d, _mm256_div_pd(d, hundred), div_mask);
+        _mm256_storeu_pd(values + i, d);
+    }
+    rk_run_sse2(src, count - i, stride, values + i, xf_indexes + i);
+}
+#endif
+#endif
+
+dllexport void unpack_rk_run(const std::byte* src, size_t count, size_t stride, double* values, uint16_t* xf_indexes, util::simd_t level)
+{
+    switch (std::min(level, util::simd_level())) {
+#if defined(EXCELR8_HAVE_AVX2)
+    case util::simd_t::avx2:
+        rk_run_avx2(src, count, stride, values, xf_indexes);
+        break;
+#endif
+#if defined(__x86_64__) || defined(_M_X64)
+    case util::simd_t::sse2:
+        rk_run_sse2(src, count, stride, values, xf_indexes);
+        break;
+#endif
+    default:
+        rk_run_scalar(src, count, stride, values, xf_indexes);
+        break;
+    }
+}
+
+dllexport void unpack_rk_run(const std::byte* src, size_t count, size_t stride, double* values, uint16_t* xf_indexes)
+{
+    unpack_rk_run(src, count, stride, values, xf_indexes, util::simd_level());
+}
+
+dllexport rk_cell_t unpack_rk(data_view_t payload)
+{
+    if (payload.size() < 10) {
+        throw Excelr8Error(std::format("RK record too short: {} bytes", payload.size()));
+    }
+    auto p = payload.data();
+    return { load_u16(p), load_u16(p + 2), load_u16(p + 4), rk_to_double(load_u32(p + 6)) };
+}
+
+dllexport mulrk_t mulrk_header(data_view_t payload)
+{
+    // row, first column, then 6 bytes (xf, rk) per cell, then last column
+    size_t size = payload.size();
+    if (size < 6 or (size - 6) % 6 != 0) {
+        throw Excelr8Error(std::format("MULRK record has bad length {}", size));
+    }
+    auto p = payload.data();
+    mulrk_t result { load_u16(p), load_u16(p + 2), load_u16(p + size - 2), (size - 6) / 6 };
+    if (result.last_col < result.first_col or result.last_col - result.first_col + 1u != result.count) {
+        throw Excelr8Error(std::format("MULRK record: columns {}..{} but {} cells", result.first_col, result.last_col, result.count));
+    }
+    return result;
+}
+
+dllexport mulrk_t unpack_mulrk(data_view_t payload, double* values, uint16_t* xf_indexes)
+{
+    mulrk_t result = mulrk_header(payload);
+    unpack_rk_run(payload.data() + 4, result.count, 6, values, xf_indexes);
+    return result;
+}
+
+dllexport mulrk_t unpack_mulrk(data_view_t payload, std::vector<double>& values, std::vector<uint16_t>& xf_indexes)
+{
+    mulrk_t result = mulrk_header(payload);
+    size_t old_values = values.size();
+    size_t old_xf = xf_indexes.size();
+    values.resize(old_values + result.count);
+    xf_indexes.resize(old_xf + result.count);
+    unpack_rk_run(payload.data() + 4, result.count, 6, values.data() + old_values, xf_indexes.data() + old_xf);
+    return result;
+}
+
+dllexport mulrk_t unpack_mulrk_columns(data_view_t payload, uint16_t first_colx, uint16_t last_colx, std::vector<double>& values, std::vector<uint16_t>& xf_indexes)
+{
+    mulrk_t header = mulrk_header(payload);
+    mulrk_t result { header.row, std::max(header.first_col, first_colx), std::min(header.last_col, last_colx), 0 };
+    if (result.first_col > result.last_col) {
+        values.clear();
+        xf_indexes.clear();
+        return result;
+    }
+    result.count = result.last_col - result.first_col + 1u;
+    values.resize(result.count);
+    xf_indexes.resize(result.count);
+    unpack_rk_run(payload.data() + 4 + 6 * (result.first_col - header.first_col), result.count, 6, values.data(), xf_indexes.data());
+    return result;
+}
+
+}
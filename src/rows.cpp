@@ -0,0 +1,255 @@
+#include "excelr8/rows.hpp"
+#include "excelr8/book.hpp"
+#include "excelr8/rk.hpp"
+#include <algorithm>
+#include <format>
+#include <stdexcept>
+
+namespace excelr8::sheet {
+
+// Row of a record that holds cells, if it is one
+static std::optional<uint32_t> cell_record_row(uint16_t opcode, data_view_t data)
+{
+    if (biff::record_info(opcode).handler == biff::record_handler_t::none and opcode != biff::XL_BLANK and opcode != biff::XL_MULBLANK) {
+        return std::nullopt;
+    }
+    if (data.size() < 2) {
+        return std::nullopt;
+    }
+    return std::get<0>(data.unpack<pytype_H>());
+}
+
+// Blocks from the INDEX record (BIFF5+): each entry is the offset of a
+// DBCELL record, whose first field is the distance back to the block's
+// first ROW record. Empty if anything doesn't check out.
+static std::vector<row_index_t::block_t> blocks_from_index(const stream_view_t& stream, data_view_t index, int bv)
+{
+    std::vector<row_index_t::block_t> blocks;
+    // reserved, first row, last row + 1, reserved; rows are 4 bytes in BIFF8
+    size_t header = bv >= 80 ? 16 : 12;
+    if (index.size() < header) {
+        return {};
+    }
+    biff::record_cursor_t cursor(stream);
+    for (size_t offset = header; offset + 4 <= index.size(); offset += 4) {
+        auto [dbcell_pos] = index.unpack<pytype_I>(offset);
+        if (dbcell_pos + 4 > cursor.size()) {
+            return {};
+        }
+        cursor.seek(dbcell_pos);
+        auto dbcell = cursor.next();
+        if (!dbcell or dbcell->opcode != biff::XL_DBCELL or dbcell->payload.size() < 4) {
+            return {};
+        }
+        auto [back] = dbcell->payload.unpack<pytype_I>();
+        if (back > dbcell_pos) {
+            return {};
+        }
+        uint64_t row_pos = dbcell_pos - back;
+        cursor.seek(row_pos);
+        auto row = cursor.next();
+        if (!row or row->opcode != biff::XL_ROW or row->payload.size() < 2) {
+            return {};
+        }
+        auto [first_row] = row->payload.unpack<pytype_H>();
+        if (!blocks.empty() and first_row <= blocks.back().first_row) {
+            return {};
+        }
+        blocks.push_back({ first_row, row_pos });
+    }
+    return blocks;
+}
+
+row_index_t row_index_t::build(const book::Book& book, size_t sheetx)
+{
+    if (sheetx >= book._sh_abs_posn.size()) {
+        throw std::out_of_range(std::format("sheet index {} out of range", sheetx));
+    }
+    biff::record_cursor_t cursor(book.workbook_stream);
+    cursor.seek(book._sh_abs_posn[sheetx]);
+    book.getbof(cursor, biff::XL_WORKSHEET);
+
+    row_index_t result;
+    bool in_order = true;
+    while (true) {
+        uint64_t pos = cursor.tell();
+        auto rec = cursor.next();
+        if (!rec) {
+            break;
+        }
+        auto cls = biff::record_info(rec->opcode).cls;
+        if (rec->opcode == biff::XL_INDEX and result.blocks.empty() and book.biff_version >= 50) {
+            result.blocks = blocks_from_index(book.workbook_stream, rec->payload, book.biff_version);
+            if (!result.blocks.empty()) {
+                result.from_index_records = true;
+                return result;
+            }
+        } else if (auto rowx = cell_record_row(rec->opcode, rec->payload)) {
+            // a block per 32 rows, starting at its first cell record
+            if (result.blocks.empty() or *rowx / 32 > result.blocks.back().first_row / 32) {
+                result.blocks.push_back({ *rowx, pos });
+            } else if (*rowx < result.blocks.back().first_row) {
+                in_order = false;
+            }
+        } else if (cls == biff::record_class_t::bof) {
+            if (!biff::skip_substream(cursor)) {
+                break;
+            }
+        } else if (cls == biff::record_class_t::eof) {
+            break;
+        }
+    }
+    if (!in_order and !result.blocks.empty()) {
+        // cells out of row order: the only safe place to start is the first
+        result.blocks = { { 0, result.blocks.front().pos } };
+    }
+    return result;
+}
+
+std::optional<uint64_t> row_index_t::find(uint32_t rowx) const
+{
+    if (blocks.empty()) {
+        return std::nullopt;
+    }
+    auto it = std::upper_bound(blocks.begin(), blocks.end(), rowx, [](uint32_t r, const block_t& block) {
+        return r < block.first_row;
+    });
+    return it == blocks.begin() ? blocks.front().pos : std::prev(it)->pos;
+}
+
+row_reader_t::row_reader_t(const book::Book& book, size_t sheetx, projection_t projection)
+    : _book(&book)
+    , _sheetx(sheetx)
+    , _cursor(book.workbook_stream)
+    , _decoder(book, std::move(projection))
+{
+    if (sheetx >= book._sh_abs_posn.size()) {
+        throw std::out_of_range(std::format("sheet index {} out of range", sheetx));
+    }
+    _cursor.seek(book._sh_abs_posn[sheetx]);
+    book.getbof(_cursor, biff::XL_WORKSHEET);
+}
+
+uint32_t row_reader_t::rowx() const
+{
+    return _rowx;
+}
+
+std::span<const row_cell_t> row_reader_t::cells() const
+{
+    return _cells;
+}
+
+void row_reader_t::seek(uint32_t rowx)
+{
+    _cells.clear();
+    _nstrings = 0;
+    auto pos = _book->row_index(_sheetx)->find(rowx);
+    if (!pos) {
+        _done = true;
+        return;
+    }
+    _cursor.seek(*pos);
+    _decoder.reset();
+    _done = false;
+    _min_row = rowx;
+}
+
+void row_reader_t::put_cell(uint32_t, uint32_t colx, uint8_t type, uint16_t xf_index, double value)
+{
+    _cells.push_back({ static_cast<uint16_t>(colx), type, xf_index, value, {} });
+}
+
+void row_reader_t::put_text(uint32_t rowx, uint32_t colx, uint16_t xf_index, std::string text)
+{
+    if (_nstrings == _strings.size()) {
+        _strings.emplace_back();
+    }
+    _strings[_nstrings] = std::move(text);
+    // the view is set by _finish_row(), once _strings has stopped growing
+    put_cell(rowx, colx, biff::XL_CELL_TEXT | column_t::local_text, xf_index, static_cast<double>(_nstrings++));
+}
+
+void row_reader_t::put_numbers(uint32_t rowx, uint32_t first_colx, std::span<const double> values, std::span<const uint16_t> xf_indexes)
+{
+    for (size_t i = 0; i < values.size(); i++) {
+        put_cell(rowx, first_colx + static_cast<uint32_t>(i), biff::XL_CELL_NUMBER, xf_indexes[i], values[i]);
+    }
+}
+
+void row_reader_t::_finish_row()
+{
+    auto by_column = [](const row_cell_t& a, const row_cell_t& b) { return a.colx < b.colx; };
+    if (!std::is_sorted(_cells.begin(), _cells.end(), by_column)) {
+        std::stable_sort(_cells.begin(), _cells.end(), by_column);
+    }
+    for (auto& cell : _cells) {
+        if ((cell.type & ~column_t::local_text) != biff::XL_CELL_TEXT) {
+            continue;
+        }
+        auto index = static_cast<size_t>(cell.value);
+        if (cell.type & column_t::local_text) {
+            cell.text = _strings[index];
+        } else {
+            cell.text = _book->shared_strings.at(index);
+        }
+        cell.type = biff::XL_CELL_TEXT;
+        cell.value = 0.0;
+    }
+}
+
+bool row_reader_t::next()
+{
+    _cells.clear();
+    _nstrings = 0;
+    bool have_row = false;
+
+    while (!_done) {
+        uint64_t pos = _cursor.tell();
+        auto rec = _cursor.next();
+        if (!rec) {
+            _done = true;
+            break;
+        }
+        if (auto rowx = _decoder.row_of(rec->opcode, rec->payload)) {
+            if (*rowx < _min_row) {
+                continue;
+            }
+            if (have_row and *rowx != _rowx) {
+                // the first record of the next row: leave it for next time
+                _cursor.seek(pos);
+                break;
+            }
+            _rowx = *rowx;
+            have_row = true;
+            _decoder.decode(rec->opcode, rec->payload, *this);
+            continue;
+        }
+
+        switch (rec->opcode) {
+        case biff::XL_DIMENSION:
+        case biff::XL_DIMENSION2:
+            if (auto dims = biff::unpack_dimensions(rec->payload, _book->biff_version)) {
+                dimnrows = dims->nrows;
+                dimncols = dims->ncols;
+            }
+            break;
+        default: {
+            auto cls = biff::record_info(rec->opcode).cls;
+            if (cls == biff::record_class_t::bof) {
+                if (!biff::skip_substream(_cursor)) {
+                    _done = true;
+                }
+            } else if (cls == biff::record_class_t::eof) {
+                _done = true;
+            }
+            break;
+        }
+        }
+    }
+
+    _finish_row();
+    return have_row;
+}
+
+}
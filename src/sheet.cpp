@@ -0,0 +1,630 @@
+#include "excelr8/sheet.hpp"
+#include "excelr8/book.hpp"
+#include "excelr8/rk.hpp"
+#include "excelr8/rows.hpp"
+#include <algorithm>
+#include <cctype>
+#include <format>
+#include <stdexcept>
+
+namespace excelr8::sheet {
+
+// Index of a column name ("A" is 0, "AA" is 26)
+static uint16_t parse_column_name(std::string_view name, std::string_view spec)
+{
+    uint32_t colx = 0;
+    for (char c : name) {
+        if (!std::isalpha(static_cast<unsigned char>(c))) {
+            throw std::invalid_argument(std::format("bad column name in projection <{}>", spec));
+        }
+        colx = colx * 26 + (std::toupper(static_cast<unsigned char>(c)) - 'A' + 1);
+        if (colx > UINT16_MAX + 1u) {
+            throw std::invalid_argument(std::format("column out of range in projection <{}>", spec));
+        }
+    }
+    if (colx == 0) {
+        throw std::invalid_argument(std::format("empty column name in projection <{}>", spec));
+    }
+    return static_cast<uint16_t>(colx - 1);
+}
+
+static std::string_view trim(std::string_view s)
+{
+    while (!s.empty() and std::isspace(static_cast<unsigned char>(s.front()))) {
+        s.remove_prefix(1);
+    }
+    while (!s.empty() and std::isspace(static_cast<unsigned char>(s.back()))) {
+        s.remove_suffix(1);
+    }
+    return s;
+}
+
+projection_t& projection_t::columns(std::string_view spec)
+{
+    for (std::string_view rest = spec; !rest.empty();) {
+        size_t comma = rest.find(',');
+        std::string_view item = trim(rest.substr(0, comma));
+        rest = comma == std::string_view::npos ? std::string_view() : rest.substr(comma + 1);
+        size_t colon = item.find(':');
+        if (colon == std::string_view::npos) {
+            uint16_t colx = parse_column_name(item, spec);
+            columns(colx, colx);
+        } else {
+            columns(parse_column_name(trim(item.substr(0, colon)), spec), parse_column_name(trim(item.substr(colon + 1)), spec));
+        }
+    }
+    return *this;
+}
+
+projection_t& projection_t::columns(uint16_t first_colx, uint16_t last_colx)
+{
+    if (first_colx > last_colx) {
+        std::swap(first_colx, last_colx);
+    }
+    column_ranges.emplace_back(first_colx, last_colx);
+    std::sort(column_ranges.begin(), column_ranges.end());
+    // merge overlapping and adjacent ranges
+    size_t out = 0;
+    for (size_t i = 1; i < column_ranges.size(); i++) {
+        if (column_ranges[i].first <= column_ranges[out].second + 1u) {
+            column_ranges[out].second = std::max(column_ranges[out].second, column_ranges[i].second);
+        } else {
+            column_ranges[++out] = column_ranges[i];
+        }
+    }
+    column_ranges.resize(out + 1);
+    return *this;
+}
+
+projection_t& projection_t::rows(uint32_t first_rowx, uint32_t last_rowx)
+{
+    first_row = std::min(first_rowx, last_rowx);
+    last_row = std::max(first_rowx, last_rowx);
+    return *this;
+}
+
+bool projection_t::all() const
+{
+    return column_ranges.empty() and first_row == 0 and last_row == UINT32_MAX;
+}
+
+bool projection_t::keeps_column(uint32_t colx) const
+{
+    if (column_ranges.empty()) {
+        return true;
+    }
+    return std::any_of(column_ranges.begin(), column_ranges.end(), [colx](const auto& range) {
+        return colx >= range.first and colx <= range.second;
+    });
+}
+
+std::vector<bool> projection_t::column_mask() const
+{
+    size_t ncols = 0;
+    for (const auto& range : column_ranges) {
+        ncols = std::max<size_t>(ncols, range.second + 1u);
+    }
+    std::vector<bool> mask(column_ranges.empty() ? UINT16_MAX + 1u : ncols);
+    for (size_t colx = 0; colx < mask.size(); colx++) {
+        mask[colx] = keeps_column(static_cast<uint32_t>(colx));
+    }
+    return mask;
+}
+
+column_t::column_t(const allocator_type& alloc)
+    : _types(alloc)
+    , _xf_indexes(alloc)
+    , _values(alloc)
+    , _runs(alloc)
+{
+}
+
+column_t::column_t(const column_t& other, const allocator_type& alloc)
+    : _types(other._types, alloc)
+    , _xf_indexes(other._xf_indexes, alloc)
+    , _values(other._values, alloc)
+    , _runs(other._runs, alloc)
+{
+}
+
+column_t::column_t(column_t&& other, const allocator_type& alloc)
+    : _types(std::move(other._types), alloc)
+    , _xf_indexes(std::move(other._xf_indexes), alloc)
+    , _values(std::move(other._values), alloc)
+    , _runs(std::move(other._runs), alloc)
+{
+}
+
+size_t column_t::_run_end(size_t r) const
+{
+    return r + 1 < _runs.size() ? _runs[r + 1].first_cell : _types.size();
+}
+
+size_t column_t::_run_of_cell(size_t cell) const
+{
+    auto it = std::upper_bound(_runs.begin(), _runs.end(), cell, [](size_t c, const run_t& run) { return c < run.first_cell; });
+    return (it - _runs.begin()) - 1;
+}
+
+size_t column_t::size() const
+{
+    return _types.size();
+}
+
+bool column_t::empty() const
+{
+    return _types.empty();
+}
+
+std::optional<size_t> column_t::find(uint32_t row) const
+{
+    auto it = std::upper_bound(_runs.begin(), _runs.end(), row, [](uint32_t r, const run_t& run) { return r < run.first_row; });
+    if (it == _runs.begin()) {
+        return std::nullopt;
+    }
+    size_t r = (it - _runs.begin()) - 1;
+    size_t cell = _runs[r].first_cell + (row - _runs[r].first_row);
+    if (cell >= _run_end(r)) {
+        return std::nullopt;
+    }
+    return cell;
+}
+
+uint32_t column_t::row_of(size_t cell) const
+{
+    const run_t& run = _runs[_run_of_cell(cell)];
+    return run.first_row + static_cast<uint32_t>(cell - run.first_cell);
+}
+
+uint8_t column_t::type(size_t cell) const
+{
+    return _types[cell] & ~local_text;
+}
+
+bool column_t::is_local_text(size_t cell) const
+{
+    return (_types[cell] & local_text) != 0;
+}
+
+std::span<const uint8_t> column_t::types() const
+{
+    return _types;
+}
+
+std::span<const uint16_t> column_t::xf_indexes() const
+{
+    return _xf_indexes;
+}
+
+std::span<const double> column_t::values() const
+{
+    return _values;
+}
+
+std::span<const column_t::run_t> column_t::runs() const
+{
+    return _runs;
+}
+
+// Out-of-order rows are rare (BIFF writers emit rows in ascending order),
+// so this rebuilds the run list rather than patching it.
+size_t column_t::_insert(uint32_t row)
+{
+    std::vector<uint32_t> rows;
+    rows.reserve(_types.size() + 1);
+    for (size_t r = 0; r < _runs.size(); r++) {
+        for (size_t cell = _runs[r].first_cell; cell < _run_end(r); cell++) {
+            rows.push_back(_runs[r].first_row + static_cast<uint32_t>(cell - _runs[r].first_cell));
+        }
+    }
+    size_t pos = std::lower_bound(rows.begin(), rows.end(), row) - rows.begin();
+    rows.insert(rows.begin() + pos, row);
+    _types.insert(_types.begin() + pos, biff::XL_CELL_EMPTY);
+    _xf_indexes.insert(_xf_indexes.begin() + pos, 0);
+    _values.insert(_values.begin() + pos, 0.0);
+
+    _runs.clear();
+    for (size_t cell = 0; cell < rows.size(); cell++) {
+        if (cell == 0 or rows[cell] != rows[cell - 1] + 1) {
+            _runs.push_back({ rows[cell], static_cast<uint32_t>(cell) });
+        }
+    }
+    return pos;
+}
+
+void column_t::set(uint32_t row, uint8_t type, uint16_t xf_index, double value)
+{
+    size_t cell;
+    if (_types.empty() or row > row_of(_types.size() - 1)) {
+        cell = _types.size();
+        if (_runs.empty() or row != row_of(cell - 1) + 1) {
+            _runs.push_back({ row, static_cast<uint32_t>(cell) });
+        }
+        _types.push_back(type);
+        _xf_indexes.push_back(xf_index);
+        _values.push_back(value);
+        return;
+    }
+    if (auto found = find(row)) {
+        cell = *found;
+    } else {
+        cell = _insert(row);
+    }
+    _types[cell] = type;
+    _xf_indexes[cell] = xf_index;
+    _values[cell] = value;
+}
+
+void column_t::shrink_to_fit()
+{
+    _types.shrink_to_fit();
+    _xf_indexes.shrink_to_fit();
+    _values.shrink_to_fit();
+    _runs.shrink_to_fit();
+}
+
+size_t column_t::memory_usage() const
+{
+    return _types.capacity() * sizeof(uint8_t) + _xf_indexes.capacity() * sizeof(uint16_t)
+        + _values.capacity() * sizeof(double) + _runs.capacity() * sizeof(run_t);
+}
+
+Sheet::Sheet(std::pmr::memory_resource* resource)
+    : strings(resource)
+    , columns(resource)
+{
+}
+
+column_t& Sheet::column(uint32_t colx)
+{
+    if (colx >= columns.size()) {
+        columns.resize(colx + 1);
+    }
+    return columns[colx];
+}
+
+void Sheet::_extend(uint32_t rowx, uint32_t colx)
+{
+    nrows = std::max(nrows, rowx + 1);
+    ncols = std::max(ncols, colx + 1);
+}
+
+cell_t Sheet::cell(uint32_t rowx, uint32_t colx) const
+{
+    if (colx >= columns.size()) {
+        return {};
+    }
+    const column_t& col = columns[colx];
+    auto found = col.find(rowx);
+    if (!found) {
+        return {};
+    }
+    return { col.type(*found), col.xf_indexes()[*found], col.values()[*found] };
+}
+
+uint8_t Sheet::cell_type(uint32_t rowx, uint32_t colx) const
+{
+    return cell(rowx, colx).type;
+}
+
+std::string_view Sheet::text(const column_t& column, size_t cell) const
+{
+    if (column.type(cell) != biff::XL_CELL_TEXT) {
+        return {};
+    }
+    auto index = static_cast<size_t>(column.values()[cell]);
+    if (column.is_local_text(cell)) {
+        return strings.at(index);
+    }
+    if (shared_strings == nullptr) {
+        throw std::logic_error("Sheet::text: no shared string table");
+    }
+    return shared_strings->at(index);
+}
+
+std::string_view Sheet::cell_text(uint32_t rowx, uint32_t colx) const
+{
+    if (colx >= columns.size()) {
+        return {};
+    }
+    auto found = columns[colx].find(rowx);
+    return found ? text(columns[colx], *found) : std::string_view();
+}
+
+void Sheet::put_cell(uint32_t rowx, uint32_t colx, uint8_t type, uint16_t xf_index, double value)
+{
+    _extend(rowx, colx);
+    column(colx).set(rowx, type, xf_index, value);
+}
+
+void Sheet::put_number(uint32_t rowx, uint32_t colx, uint16_t xf_index, double value)
+{
+    put_cell(rowx, colx, biff::XL_CELL_NUMBER, xf_index, value);
+}
+
+void Sheet::put_boolean(uint32_t rowx, uint32_t colx, uint16_t xf_index, bool value)
+{
+    put_cell(rowx, colx, biff::XL_CELL_BOOLEAN, xf_index, value ? 1.0 : 0.0);
+}
+
+void Sheet::put_error(uint32_t rowx, uint32_t colx, uint16_t xf_index, uint8_t code)
+{
+    put_cell(rowx, colx, biff::XL_CELL_ERROR, xf_index, code);
+}
+
+void Sheet::put_blank(uint32_t rowx, uint32_t colx, uint16_t xf_index)
+{
+    put_cell(rowx, colx, biff::XL_CELL_BLANK, xf_index, 0.0);
+}
+
+void Sheet::put_sst_text(uint32_t rowx, uint32_t colx, uint16_t xf_index, uint32_t sst_index)
+{
+    put_cell(rowx, colx, biff::XL_CELL_TEXT, xf_index, sst_index);
+}
+
+void Sheet::put_text(uint32_t rowx, uint32_t colx, uint16_t xf_index, std::string text)
+{
+    _extend(rowx, colx);
+    strings.emplace_back(text);
+    column(colx).set(rowx, biff::XL_CELL_TEXT | column_t::local_text, xf_index, static_cast<double>(strings.size() - 1));
+}
+
+void Sheet::put_numbers(uint32_t rowx, uint32_t first_colx, std::span<const double> values, std::span<const uint16_t> xf_indexes)
+{
+    if (values.empty()) {
+        return;
+    }
+    uint32_t last_colx = first_colx + static_cast<uint32_t>(values.size()) - 1;
+    _extend(rowx, last_colx);
+    column(last_colx);
+    for (size_t i = 0; i < values.size(); i++) {
+        columns[first_colx + i].set(rowx, biff::XL_CELL_NUMBER, xf_indexes[i], values[i]);
+    }
+}
+
+void Sheet::put_mulrk(data_view_t payload, uint16_t first_colx, uint16_t last_colx)
+{
+    auto mulrk = biff::unpack_mulrk_columns(payload, first_colx, last_colx, _rk_values, _rk_xf_indexes);
+    put_numbers(mulrk.row, mulrk.first_col, _rk_values, _rk_xf_indexes);
+}
+
+void Sheet::read(const book::Book& book, biff::record_cursor_t& cursor, const projection_t& projection)
+{
+    cell_decoder_t decoder(book, projection);
+    while (auto rec = cursor.next()) {
+        if (decoder.decode(rec->opcode, rec->payload, *this)) {
+            continue;
+        }
+        switch (rec->opcode) {
+        case biff::XL_DIMENSION:
+        case biff::XL_DIMENSION2:
+            if (auto dims = biff::unpack_dimensions(rec->payload, book.biff_version)) {
+                dimnrows = dims->nrows;
+                dimncols = dims->ncols;
+            }
+            break;
+        default: {
+            auto cls = biff::record_info(rec->opcode).cls;
+            if (cls == biff::record_class_t::bof) {
+                if (!biff::skip_substream(cursor)) {
+                    return;
+                }
+            } else if (cls == biff::record_class_t::eof) {
+                return;
+            }
+            break;
+        }
+        }
+    }
+}
+
+void Sheet::shrink_to_fit()
+{
+    for (auto& col : columns) {
+        col.shrink_to_fit();
+    }
+    columns.shrink_to_fit();
+    strings.shrink_to_fit();
+    std::vector<double>().swap(_rk_values);
+    std::vector<uint16_t>().swap(_rk_xf_indexes);
+}
+
+size_t Sheet::memory_usage() const
+{
+    size_t total = columns.capacity() * sizeof(column_t) + strings.capacity() * sizeof(std::pmr::string);
+    for (const auto& col : columns) {
+        total += col.memory_usage();
+    }
+    for (const auto& s : strings) {
+        total += s.capacity();
+    }
+    return total + _rk_values.capacity() * sizeof(double) + _rk_xf_indexes.capacity() * sizeof(uint16_t);
+}
+
+cell_decoder_t::cell_decoder_t(const book::Book& book, projection_t projection)
+    : _bv(book.biff_version)
+    , _formatting_info(book.formatting_info)
+    , _codec(&book.codec)
+    , _projection(std::move(projection))
+    , _column_mask(_projection.column_mask())
+{
+}
+
+void cell_decoder_t::reset()
+{
+    _string_pending = false;
+}
+
+std::optional<cell_decoder_t::extent_t> cell_decoder_t::_extent(uint16_t opcode, data_view_t data) const
+{
+    using biff::record_handler_t;
+    auto handler = biff::record_info(opcode).handler;
+    if (handler == record_handler_t::mulrk) {
+        auto mulrk = biff::mulrk_header(data);
+        return extent_t { mulrk.row, mulrk.first_col, mulrk.last_col };
+    }
+    if (handler == record_handler_t::formula and _bv < 30) {
+        return std::nullopt; // BIFF2 formulas are not supported
+    }
+    if (handler != record_handler_t::none or (opcode == biff::XL_BLANK and _formatting_info)) {
+        // these cell records start with the cell's row and column
+        auto [rowx, colx] = data.unpack<pytype_H, pytype_H>();
+        return extent_t { rowx, colx, colx };
+    }
+    if (opcode == biff::XL_MULBLANK and _formatting_info) {
+        if (auto mulblank = biff::mulblank_header(data)) {
+            return extent_t { mulblank->row, mulblank->first_col, static_cast<uint16_t>(mulblank->first_col + mulblank->count - 1) };
+        }
+        return std::nullopt;
+    }
+    if (opcode == biff::XL_STRING and _string_pending) {
+        return extent_t { _string_rowx, _string_colx, _string_colx };
+    }
+    return std::nullopt;
+}
+
+bool cell_decoder_t::_keeps(uint32_t rowx, uint32_t colx) const
+{
+    return _projection.keeps_row(rowx) and colx < _column_mask.size() and _column_mask[colx];
+}
+
+bool cell_decoder_t::_keeps_any(const extent_t& extent) const
+{
+    if (!_projection.keeps_row(extent.rowx)) {
+        return false;
+    }
+    for (uint32_t colx = extent.first_colx; colx <= extent.last_colx and colx < _column_mask.size(); colx++) {
+        if (_column_mask[colx]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::optional<uint32_t> cell_decoder_t::row_of(uint16_t opcode, data_view_t payload) const
+{
+    auto extent = _extent(opcode, payload);
+    if (!extent or !_keeps_any(*extent)) {
+        return std::nullopt;
+    }
+    return extent->rowx;
+}
+
+template <typename Sink>
+bool cell_decoder_t::decode(uint16_t opcode, data_view_t data, Sink& sink)
+{
+    using biff::record_handler_t;
+    auto extent = _extent(opcode, data);
+    if (!extent) {
+        return false;
+    }
+    if (!_keeps_any(*extent)) {
+        return true;
+    }
+    uint32_t rowx = extent->rowx;
+
+    switch (biff::record_info(opcode).handler) {
+    case record_handler_t::number: {
+        auto [row, colx, xf_index, d] = data.unpack<pytype_H, pytype_H, pytype_H, pytype_d>();
+        sink.put_cell(rowx, colx, biff::XL_CELL_NUMBER, xf_index, d);
+        return true;
+    }
+    case record_handler_t::rk: {
+        auto rk = biff::unpack_rk(data);
+        sink.put_cell(rowx, rk.col, biff::XL_CELL_NUMBER, rk.xf_index, rk.value);
+        return true;
+    }
+    case record_handler_t::mulrk: {
+        auto put_columns = [&](uint16_t first_colx, uint16_t last_colx) {
+            auto mulrk = biff::unpack_mulrk_columns(data, first_colx, last_colx, _rk_values, _rk_xf_indexes);
+            if (mulrk.count != 0) {
+                sink.put_numbers(rowx, mulrk.first_col, std::span<const double>(_rk_values), std::span<const uint16_t>(_rk_xf_indexes));
+            }
+        };
+        if (_projection.column_ranges.empty()) {
+            put_columns(0, UINT16_MAX);
+        } else {
+            for (const auto& [first_colx, last_colx] : _projection.column_ranges) {
+                put_columns(first_colx, last_colx);
+            }
+        }
+        return true;
+    }
+    case record_handler_t::labelsst: {
+        auto [row, colx, xf_index, sstindex] = data.unpack<pytype_H, pytype_H, pytype_H, pytype_i>();
+        sink.put_cell(rowx, colx, biff::XL_CELL_TEXT, xf_index, sstindex);
+        return true;
+    }
+    case record_handler_t::label:
+    case record_handler_t::rstring: {
+        auto [row, colx, xf_index] = data.unpack<pytype_H, pytype_H, pytype_H>();
+        sink.put_text(rowx, colx, xf_index, biff::unpack_cell_text(data, 6, _bv, *_codec));
+        return true;
+    }
+    case record_handler_t::boolerr: {
+        auto [row, colx, xf_index, value, is_err] = data.unpack<pytype_H, pytype_H, pytype_H, pytype_B, pytype_B>();
+        if (is_err) {
+            sink.put_cell(rowx, colx, biff::XL_CELL_ERROR, xf_index, value);
+        } else {
+            sink.put_cell(rowx, colx, biff::XL_CELL_BOOLEAN, xf_index, value != 0 ? 1.0 : 0.0);
+        }
+        return true;
+    }
+    case record_handler_t::formula: {
+        auto [row, colx, xf_index] = data.unpack<pytype_H, pytype_H, pytype_H>();
+        auto result = biff::unpack_formula_result(data);
+        switch (result.kind) {
+        case biff::formula_result_t::kind_t::number:
+            sink.put_cell(rowx, colx, biff::XL_CELL_NUMBER, xf_index, result.value);
+            break;
+        case biff::formula_result_t::kind_t::string:
+            _string_pending = true;
+            _string_rowx = rowx;
+            _string_colx = colx;
+            _string_xf_index = xf_index;
+            break;
+        case biff::formula_result_t::kind_t::boolean:
+            sink.put_cell(rowx, colx, biff::XL_CELL_BOOLEAN, xf_index, result.value);
+            break;
+        case biff::formula_result_t::kind_t::error:
+            sink.put_cell(rowx, colx, biff::XL_CELL_ERROR, xf_index, result.value);
+            break;
+        case biff::formula_result_t::kind_t::empty_string:
+            sink.put_text(rowx, colx, xf_index, "");
+            break;
+        case biff::formula_result_t::kind_t::unknown:
+            break;
+        }
+        return true;
+    }
+    case record_handler_t::none:
+        break;
+    }
+
+    switch (opcode) {
+    case biff::XL_STRING:
+        sink.put_text(_string_rowx, _string_colx, _string_xf_index, biff::unpack_cell_text(data, 0, _bv, *_codec));
+        _string_pending = false;
+        break;
+    case biff::XL_BLANK: {
+        auto [row, colx, xf_index] = data.unpack<pytype_H, pytype_H, pytype_H>();
+        sink.put_cell(rowx, colx, biff::XL_CELL_BLANK, xf_index, 0.0);
+        break;
+    }
+    case biff::XL_MULBLANK:
+        // row, first column, an XF index per cell, last column
+        for (uint32_t colx = extent->first_colx; colx <= extent->last_colx; colx++) {
+            if (_keeps(rowx, colx)) {
+                auto [xf_index] = data.unpack<pytype_H>(4 + 2 * (colx - extent->first_colx));
+                sink.put_cell(rowx, colx, biff::XL_CELL_BLANK, xf_index, 0.0);
+            }
+        }
+        break;
+    }
+    return true;
+}
+
+template bool cell_decoder_t::decode<Sheet>(uint16_t, data_view_t, Sheet&);
+template bool cell_decoder_t::decode<row_reader_t>(uint16_t, data_view_t, row_reader_t&);
+
+}
@@ -0,0 +1,208 @@
+#include "excelr8/source.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+
+#if defined _WIN32 || defined __CYGWIN__
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace excelr8 {
+
+memory_source_t::memory_source_t(data_view_t data)
+    : _data(data)
+{
+}
+
+uint64_t memory_source_t::size() const
+{
+    return _data.size();
+}
+
+size_t memory_source_t::read(uint64_t offset, size_t count, std::byte* dst) const
+{
+    if (offset >= _data.size()) {
+        return 0;
+    }
+    auto range = _data.slice(offset, offset + std::min<uint64_t>(count, _data.size() - offset));
+    if (!range.empty()) {
+        std::memcpy(dst, range.data(), range.size());
+    }
+    return range.size();
+}
+
+const std::byte* memory_source_t::resident() const
+{
+    return _data.data();
+}
+
+#if defined _WIN32 || defined __CYGWIN__
+
+pread_source_t::pread_source_t(const std::filesystem::path& filename, size_t block_size, size_t capacity)
+    : _block_size(block_size)
+    , _capacity(std::max<size_t>(capacity, 1))
+{
+    HANDLE file = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::system_error(GetLastError(), std::system_category(), filename.string());
+    }
+    _file = file;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        auto err = GetLastError();
+        CloseHandle(file);
+        throw std::system_error(err, std::system_category(), filename.string());
+    }
+    _size = size.QuadPart;
+}
+
+pread_source_t::~pread_source_t()
+{
+    CloseHandle(_file);
+}
+
+size_t pread_source_t::_pread(uint64_t offset, size_t count, std::byte* dst) const
+{
+    size_t done = 0;
+    while (done < count) {
+        OVERLAPPED ov = {};
+        ov.Offset = static_cast<DWORD>(offset + done);
+        ov.OffsetHigh = static_cast<DWORD>((offset + done) >> 32);
+        DWORD chunk = static_cast<DWORD>(std::min<size_t>(count - done, 1 << 30));
+        DWORD got = 0;
+        if (!ReadFile(_file, dst + done, chunk, &got, &ov)) {
+            auto err = GetLastError();
+            if (err == ERROR_HANDLE_EOF) {
+                break;
+            }
+            throw std::system_error(err, std::system_category(), "ReadFile");
+        }
+        if (got == 0) {
+            break;
+        }
+        done += got;
+    }
+    return done;
+}
+
+#else
+
+pread_source_t::pread_source_t(const std::filesystem::path& filename, size_t block_size, size_t capacity)
+    : _block_size(block_size)
+    , _capacity(std::max<size_t>(capacity, 1))
+{
+    _fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (_fd < 0) {
+        throw std::system_error(errno, std::generic_category(), filename.string());
+    }
+
+    struct stat st;
+    if (::fstat(_fd, &st) != 0) {
+        int err = errno;
+        ::close(_fd);
+        throw std::system_error(err, std::generic_category(), filename.string());
+    }
+    _size = st.st_size;
+}
+
+pread_source_t::~pread_source_t()
+{
+    ::close(_fd);
+}
+
+size_t pread_source_t::_pread(uint64_t offset, size_t count, std::byte* dst) const
+{
+    static_assert(sizeof(off_t) == 8, "build with _FILE_OFFSET_BITS=64");
+    size_t done = 0;
+    while (done < count) {
+        ssize_t got = ::pread(_fd, dst + done, count - done, offset + done);
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::system_error(errno, std::generic_category(), "pread");
+        }
+        if (got == 0) {
+            break; // end of file
+        }
+        done += got;
+    }
+    return done;
+}
+
+#endif
+
+uint64_t pread_source_t::size() const
+{
+    return _size;
+}
+
+const pread_source_t::block_t& pread_source_t::_block(uint64_t index) const
+{
+    auto it = _cache.find(index);
+    if (it != _cache.end()) {
+        _lru.splice(_lru.begin(), _lru, it->second);
+        return *it->second;
+    }
+
+    if (_lru.size() >= _capacity) {
+        // recycle the least recently used block's buffer
+        _cache.erase(_lru.back().index);
+        _lru.splice(_lru.begin(), _lru, std::prev(_lru.end()));
+    } else {
+        _lru.emplace_front();
+    }
+    auto& block = _lru.front();
+    block.index = index;
+    block.bytes.resize(_block_size);
+    block.bytes.resize(_pread(index * _block_size, _block_size, block.bytes.data()));
+    _cache[index] = _lru.begin();
+    return block;
+}
+
+size_t pread_source_t::read(uint64_t offset, size_t count, std::byte* dst) const
+{
+    if (offset >= _size) {
+        return 0;
+    }
+    count = std::min<uint64_t>(count, _size - offset);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    size_t done = 0;
+    while (done < count) {
+        uint64_t pos = offset + done;
+        uint64_t index = pos / _block_size;
+        size_t within = pos % _block_size;
+        size_t grab = std::min(count - done, _block_size - within);
+
+        if (within == 0 and grab == _block_size and !_cache.contains(index)) {
+            // whole uncached blocks go straight to the caller, so a big
+            // sequential read doesn't flush the cache
+            size_t whole = (count - done) / _block_size * _block_size;
+            size_t got = _pread(pos, whole, dst + done);
+            done += got;
+            if (got < whole) {
+                break;
+            }
+            continue;
+        }
+
+        const auto& block = _block(index);
+        if (within >= block.bytes.size()) {
+            break;
+        }
+        grab = std::min(grab, block.bytes.size() - within);
+        std::memcpy(dst + done, block.bytes.data() + within, grab);
+        done += grab;
+    }
+    return done;
+}
+
+}
@@ -0,0 +1,405 @@
+#include "excelr8/sst.hpp"
+#include "excelr8/biff.hpp"
+#include "excelr8/util.hpp"
+#include <algorithm>
+#include <atomic>
+#include <format>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace excelr8::book {
+
+// Where a string's characters start, for decoding it on first access
+struct raw_string_t {
+    uint64_t pos; // first character, after the header
+    uint32_t seg; // record pos falls in
+    uint16_t nchars;
+    uint8_t options; // compressed/uncompressed flag for the first piece
+};
+
+struct sst_t::lazy_t {
+    explicit lazy_t(std::pmr::memory_resource* resource)
+        : payload(resource)
+        , raw(resource)
+        , arena(resource)
+    {
+    }
+
+    std::pmr::vector<std::byte> payload;
+    std::vector<size_t> segments;
+    std::pmr::vector<raw_string_t> raw;
+
+    // A decoded string is published by storing bytes (release) after
+    // length, so a reader that loads bytes (acquire) and finds it set can
+    // use the entry without taking the mutex.
+    struct decoded_t {
+        std::atomic<const char*> bytes = nullptr;
+        size_t length = 0;
+    };
+    std::unique_ptr<decoded_t[]> decoded;
+
+    std::mutex mutex; // serializes first decodes: arena, scratch, decoded_bytes
+    std::pmr::monotonic_buffer_resource arena; // never moves what it handed out
+    std::pmr::string scratch;
+    size_t decoded_bytes = 0;
+};
+
+sst_t::sst_t() = default;
+
+sst_t::sst_t(std::pmr::memory_resource* resource)
+    : _arena(resource)
+    , _offsets(1, 0, resource)
+{
+}
+
+sst_t::sst_t(sst_t&&) noexcept = default;
+sst_t& sst_t::operator=(sst_t&&) noexcept = default;
+sst_t::~sst_t() = default;
+
+size_t sst_t::size() const
+{
+    return _lazy ? _lazy->raw.size() : _offsets.size() - 1;
+}
+
+bool sst_t::empty() const
+{
+    return size() == 0;
+}
+
+bool sst_t::lazy() const
+{
+    return _lazy != nullptr;
+}
+
+size_t sst_t::arena_size() const
+{
+    if (_lazy) {
+        std::lock_guard lock(_lazy->mutex);
+        return _lazy->decoded_bytes;
+    }
+    return _arena.size();
+}
+
+std::string_view sst_t::operator[](size_t index) const
+{
+    if (_lazy) {
+        return _decode(index);
+    }
+    return std::string_view(_arena).substr(_offsets[index], _offsets[index + 1] - _offsets[index]);
+}
+
+std::string_view sst_t::at(size_t index) const
+{
+    if (index >= size()) {
+        throw std::out_of_range(std::format("SST index {} out of range ({} strings)", index, size()));
+    }
+    return (*this)[index];
+}
+
+// Segment (record) of the joined payload that pos falls in
+static size_t segment_of(const std::vector<size_t>& segments, size_t pos)
+{
+    auto it = std::upper_bound(segments.begin(), segments.end(), pos);
+    return it == segments.begin() ? 0 : (it - segments.begin()) - 1;
+}
+
+// Walks the nchars characters of string index starting at pos in record seg,
+// appending their UTF-8 to out unless it is null; returns the position just
+// past them. Where the characters run into the next CONTINUE record, that
+// record starts with a new option byte.
+static size_t read_chars(data_view_t data, const std::vector<size_t>& segments, size_t& seg, size_t pos,
+    uint8_t options, size_t nchars, std::pmr::string* out, size_t index)
+{
+    auto seg_end = [&]() { return seg + 1 < segments.size() ? segments[seg + 1] : data.size(); };
+    size_t charsgot = 0;
+    char16_t carry = 0;
+    while (true) {
+        size_t charsneed = nchars - charsgot;
+        size_t end = seg_end();
+        size_t charsavail;
+        if (options & 0x01) {
+            // Uncompressed UTF-16-LE
+            charsavail = std::min((end - std::min(pos, end)) >> 1, charsneed);
+            if (out != nullptr) {
+                size_t old_size = out->size();
+                out->resize(old_size + util::utf16le_utf8_capacity(charsavail));
+                out->resize(old_size + util::utf16le_to_utf8(data.slice(pos, pos + 2 * charsavail), out->data() + old_size, &carry));
+            }
+            pos += 2 * charsavail;
+        } else {
+            // Compressed: the high byte of every UTF-16 unit is zero
+            charsavail = std::min(end - std::min(pos, end), charsneed);
+            if (out != nullptr) {
+                size_t old_size = out->size();
+                out->resize(old_size + util::latin1_utf8_capacity(charsavail));
+                out->resize(old_size + util::latin1_to_utf8(data.slice(pos, pos + charsavail), out->data() + old_size));
+            }
+            pos += charsavail;
+        }
+        charsgot += charsavail;
+        if (charsgot == nchars) {
+            break;
+        }
+        if (seg + 1 >= segments.size()) {
+            throw biff::Excelr8Error(std::format("SST string {} is truncated", index));
+        }
+        seg += 1;
+        pos = segments[seg];
+        options = std::get<0>(data.unpack<pytype_B>(pos));
+        pos += 1;
+    }
+    if (carry != 0 and out != nullptr) {
+        *out += "\xEF\xBF\xBD"; // a high surrogate nothing followed: U+FFFD
+    }
+    return pos;
+}
+
+// Walks strings [first, first + count) starting at pos, handing where each
+// one's characters start to on_string(raw) and, if arena is given, appending its
+// UTF-8 to arena and its end offset to ends; returns the position just past
+// the last one. A port of the loop in xlrd's unpack_SST_table working on
+// the joined payload: a position only has to be moved explicitly where a
+// string's characters continue into the next record.
+template <typename OnString>
+static size_t walk_strings(data_view_t data, const std::vector<size_t>& segments, size_t pos,
+    int first, int count, std::pmr::string* arena, std::pmr::vector<uint64_t>* ends, OnString on_string)
+{
+    size_t seg = segment_of(segments, pos);
+    auto seg_end = [&]() { return seg + 1 < segments.size() ? segments[seg + 1] : data.size(); };
+
+    for (int i = first; i < first + count; i++) {
+        while (pos >= seg_end() and seg + 1 < segments.size()) {
+            seg += 1;
+        }
+        auto [nchars, options] = data.unpack<pytype_H, pytype_B>(pos);
+        pos += 3;
+        int rtcount = 0, phosz = 0;
+        if (options & 0x08) { // richtext
+            rtcount = std::get<0>(data.unpack<pytype_H>(pos));
+            pos += 2;
+        }
+        if (options & 0x04) { // phonetic
+            phosz = std::get<0>(data.unpack<pytype_i>(pos));
+            pos += 4;
+        }
+        on_string(raw_string_t { pos, static_cast<uint32_t>(seg), nchars, options });
+
+        pos = read_chars(data, segments, seg, pos, options, nchars, arena, i);
+        // Rich-text runs and phonetic data may spill into the next CONTINUE
+        // record too, but without an option byte, so skipping is just adding.
+        pos += 4 * rtcount + std::max(phosz, 0);
+        if (ends != nullptr) {
+            ends->push_back(arena->size());
+        }
+    }
+    return pos;
+}
+
+static size_t decode_strings(data_view_t data, const std::vector<size_t>& segments, size_t pos,
+    int first, int count, std::pmr::string& arena, std::pmr::vector<uint64_t>& ends)
+{
+    return walk_strings(data, segments, pos, first, count, &arena, &ends, [](const raw_string_t&) {});
+}
+
+std::string_view sst_t::_decode(size_t index) const
+{
+    auto& lazy = *_lazy;
+    auto& entry = lazy.decoded[index];
+    if (auto bytes = entry.bytes.load(std::memory_order_acquire)) {
+        return std::string_view(bytes, entry.length);
+    }
+    std::lock_guard lock(lazy.mutex);
+    // another thread may have decoded it while this one waited
+    if (auto bytes = entry.bytes.load(std::memory_order_relaxed)) {
+        return std::string_view(bytes, entry.length);
+    }
+    const auto& raw = lazy.raw[index];
+    data_view_t data(lazy.payload.data(), lazy.payload.size());
+    size_t seg = raw.seg;
+    lazy.scratch.clear();
+    read_chars(data, lazy.segments, seg, raw.pos, raw.options, raw.nchars, &lazy.scratch, index);
+
+    auto bytes = static_cast<char*>(lazy.arena.allocate(std::max<size_t>(lazy.scratch.size(), 1), 1));
+    std::copy(lazy.scratch.begin(), lazy.scratch.end(), bytes);
+    lazy.decoded_bytes += lazy.scratch.size();
+    entry.length = lazy.scratch.size();
+    entry.bytes.store(bytes, std::memory_order_release);
+    return std::string_view(bytes, entry.length);
+}
+
+sst_t index_sst_table(data_view_t data, const std::vector<size_t>& segments, std::pmr::memory_resource* resource)
+{
+    sst_t sst(resource);
+    if (data.size() < 8) {
+        throw biff::Excelr8Error("SST record is truncated");
+    }
+    [[maybe_unused]] auto [total_refs, nstrings] = data.unpack<pytype_i, pytype_i>();
+    if (nstrings < 0) {
+        throw biff::Excelr8Error(std::format("SST claims {} strings", nstrings));
+    }
+
+    // The raw bytes have to outlive the record cursor's buffer
+    sst._lazy = std::make_unique<sst_t::lazy_t>(resource);
+    auto& lazy = *sst._lazy;
+    lazy.payload.assign(data.begin(), data.end());
+    lazy.segments = segments.empty() ? std::vector<size_t> { 0 } : segments;
+    lazy.raw.reserve(std::min<size_t>(nstrings, data.size() / 3));
+    walk_strings(data, lazy.segments, 8, 0, nstrings, nullptr, nullptr, [&](const raw_string_t& raw) {
+        lazy.raw.push_back(raw);
+    });
+    lazy.decoded = std::make_unique<sst_t::lazy_t::decoded_t[]>(lazy.raw.size());
+    return sst;
+}
+
+static std::vector<size_t> sst_bucket_positions(data_view_t extsst, uint64_t sst_offset, const std::vector<size_t>& segments,
+    size_t payload_size, int nstrings, int& strings_per_bucket)
+{
+    // EXTSST: dsst (strings per bucket), then for each bucket the stream
+    // position of its first string and that string's offset within its
+    // SST/CONTINUE record, header included
+    std::vector<size_t> positions;
+    if (extsst.size() < 2 or nstrings <= 0) {
+        return {};
+    }
+    strings_per_bucket = std::get<0>(extsst.unpack<pytype_H>());
+    if (strings_per_bucket == 0) {
+        return {};
+    }
+    size_t nbuckets = (nstrings + strings_per_bucket - 1) / strings_per_bucket;
+    if ((extsst.size() - 2) / 8 < nbuckets) {
+        return {};
+    }
+    for (size_t b = 0; b < nbuckets; b++) {
+        auto [ib, cb] = extsst.unpack<pytype_I, pytype_H>(2 + 8 * b);
+        if (cb < 4 or ib < cb) {
+            return {};
+        }
+        // Find the record starting there: record k's header is at its
+        // payload offset plus the k + 1 headers before that payload, less one
+        uint64_t record_start = ib - cb;
+        auto header = [&](size_t k) { return sst_offset + segments[k] + 4 * k; };
+        size_t lo = 0, hi = segments.size();
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (header(mid) < record_start) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        size_t k = lo;
+        if (k == segments.size() or header(k) != record_start) {
+            return {};
+        }
+        size_t pos = segments[k] + cb - 4;
+        size_t end = k + 1 < segments.size() ? segments[k + 1] : payload_size;
+        if (pos >= end or (!positions.empty() and pos <= positions.back())) {
+            return {};
+        }
+        positions.push_back(pos);
+    }
+    return positions;
+}
+
+sst_t unpack_sst_table(data_view_t data, const std::vector<size_t>& segments, data_view_t extsst, uint64_t sst_offset, unsigned nthreads,
+    std::pmr::memory_resource* resource)
+{
+    sst_t sst(resource);
+    if (data.size() < 8) {
+        throw biff::Excelr8Error("SST record is truncated");
+    }
+    [[maybe_unused]] auto [total_refs, nstrings] = data.unpack<pytype_i, pytype_i>();
+    if (nstrings < 0) {
+        throw biff::Excelr8Error(std::format("SST claims {} strings", nstrings));
+    }
+
+    if (nthreads == 0) {
+        nthreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    int strings_per_bucket = 0;
+    std::vector<size_t> buckets;
+    if (nthreads > 1 and !extsst.empty() and data.size() >= sst_parallel_min_size) {
+        buckets = sst_bucket_positions(extsst, sst_offset, segments, data.size(), nstrings, strings_per_bucket);
+    }
+    if (buckets.size() >= 2 and buckets[0] == 8) {
+        // Give each worker a run of whole buckets; a run must end exactly
+        // where the next one's EXTSST entry says, or EXTSST is not to be
+        // trusted and the table is decoded sequentially after all.
+        size_t nchunks = std::min<size_t>(nthreads, buckets.size());
+        struct chunk_t {
+            int first, count;
+            size_t start, expected_end;
+            std::pmr::string arena;
+            std::pmr::vector<uint64_t> ends;
+            bool ok = false;
+        };
+        std::vector<chunk_t> chunks(nchunks);
+        for (size_t c = 0; c < nchunks; c++) {
+            size_t b0 = buckets.size() * c / nchunks, b1 = buckets.size() * (c + 1) / nchunks;
+            chunks[c].first = b0 * strings_per_bucket;
+            chunks[c].count = std::min<int>(b1 * strings_per_bucket, nstrings) - chunks[c].first;
+            chunks[c].start = buckets[b0];
+            chunks[c].expected_end = b1 < buckets.size() ? buckets[b1] : 0; // 0: runs to the end
+        }
+
+        auto decode_chunk = [&](chunk_t& chunk) {
+            try {
+                chunk.arena.reserve((chunk.expected_end ? chunk.expected_end : data.size()) - chunk.start);
+                chunk.ends.reserve(chunk.count);
+                size_t end = decode_strings(data, segments, chunk.start, chunk.first, chunk.count, chunk.arena, chunk.ends);
+                chunk.ok = chunk.expected_end == 0 or end == chunk.expected_end;
+            } catch (const std::exception&) {
+                chunk.ok = false; // possibly a bad bucket offset; retried sequentially below
+            }
+        };
+        std::vector<std::thread> workers;
+        size_t started = 1;
+        try {
+            for (; started < nchunks; started++) {
+                workers.emplace_back(decode_chunk, std::ref(chunks[started]));
+            }
+        } catch (const std::system_error&) {
+            // no more threads to be had: the calling thread does the rest
+        }
+        decode_chunk(chunks[0]);
+        for (size_t c = started; c < nchunks; c++) {
+            decode_chunk(chunks[c]);
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+
+        if (std::all_of(chunks.begin(), chunks.end(), [](const chunk_t& chunk) { return chunk.ok; })) {
+            size_t total = 0;
+            for (const auto& chunk : chunks) {
+                total += chunk.arena.size();
+            }
+            sst._arena.reserve(total);
+            sst._offsets.reserve(nstrings + 1);
+            for (const auto& chunk : chunks) {
+                uint64_t base = sst._arena.size();
+                sst._arena += chunk.arena;
+                for (auto end : chunk.ends) {
+                    sst._offsets.push_back(base + end);
+                }
+            }
+            return sst;
+        }
+    }
+
+    // Every string takes at least 3 bytes, which bounds what a corrupt count can reserve
+    sst._offsets.reserve(std::min<size_t>(nstrings, data.size() / 3) + 1);
+    sst._arena.reserve(data.size());
+    decode_strings(data, segments, 8, 0, nstrings, sst._arena, sst._offsets);
+    sst._arena.shrink_to_fit();
+    return sst;
+}
+
+}
@@ -0,0 +1,208 @@
+#include "excelr8/stream.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace excelr8 {
+
+stream_view_t::stream_view_t(std::shared_ptr<const byte_source_t> source, const std::vector<extent_t>& extents)
+    : _source(std::move(source))
+    , _resident(_source ? _source->resident() : nullptr)
+{
+    uint64_t source_size = _source ? _source->size() : 0;
+    for (auto [offset, length] : extents) {
+        // clamp to the source, as a truncated file would be sliced
+        if (offset >= source_size) {
+            continue;
+        }
+        length = std::min(length, source_size - offset);
+        if (length == 0) {
+            continue;
+        }
+
+        if (!_extents.empty() and _extents.back().offset + _extents.back().length == offset) {
+            _extents.back().length += length;
+        } else {
+            _starts.push_back(_size);
+            _extents.push_back({ offset, length });
+        }
+        _size += length;
+    }
+}
+
+stream_view_t::stream_view_t(std::shared_ptr<const byte_source_t> source)
+    : stream_view_t(source, { { 0, source->size() } })
+{
+}
+
+stream_view_t::stream_view_t(data_view_t base)
+    : stream_view_t(std::make_shared<memory_source_t>(base))
+{
+}
+
+uint64_t stream_view_t::size() const
+{
+    return _size;
+}
+
+bool stream_view_t::empty() const
+{
+    return _size == 0;
+}
+
+const std::vector<extent_t>& stream_view_t::extents() const
+{
+    return _extents;
+}
+
+const std::shared_ptr<const byte_source_t>& stream_view_t::source() const
+{
+    return _source;
+}
+
+bool stream_view_t::contiguous() const
+{
+    return _extents.size() <= 1;
+}
+
+data_view_t stream_view_t::contiguous_view() const
+{
+    if (_extents.empty()) {
+        return {};
+    }
+    if (_extents.size() != 1) {
+        throw std::logic_error("stream is fragmented into " + std::to_string(_extents.size()) + " extents");
+    }
+    if (_resident == nullptr) {
+        throw std::logic_error("stream source is not resident in memory");
+    }
+    return { _resident + _extents[0].offset, _extents[0].length };
+}
+
+data_t stream_view_t::materialize() const
+{
+    std::vector<std::byte> buffer(_size);
+    size_t done = 0;
+    for (const auto& [offset, length] : _extents) {
+        done += _source->read(offset, length, buffer.data() + done);
+    }
+    buffer.resize(done);
+    return data_t(std::move(buffer));
+}
+
+size_t stream_view_t::_find_extent(uint64_t pos) const
+{
+    // last extent starting at or before pos
+    auto it = std::upper_bound(_starts.begin(), _starts.end(), pos);
+    return it == _starts.begin() ? 0 : it - _starts.begin() - 1;
+}
+
+stream_view_t stream_view_t::substream(const std::vector<extent_t>& logical_extents) const
+{
+    std::vector<extent_t> physical;
+    for (auto [offset, length] : logical_extents) {
+        if (offset >= _size) {
+            continue;
+        }
+        length = std::min(length, _size - offset);
+        for (size_t i = _find_extent(offset); length > 0 and i < _extents.size(); i++) {
+            uint64_t skip = offset - _starts[i];
+            uint64_t grab = std::min(length, _extents[i].length - skip);
+            physical.push_back({ _extents[i].offset + skip, grab });
+            offset += grab;
+            length -= grab;
+        }
+    }
+    return { _source, physical };
+}
+
+uint64_t stream_view_t::tell() const
+{
+    return _pos;
+}
+
+uint64_t stream_view_t::remaining() const
+{
+    return _size - _pos;
+}
+
+bool stream_view_t::eof() const
+{
+    return _pos >= _size;
+}
+
+void stream_view_t::seek(uint64_t pos)
+{
+    if (pos > _size) {
+        throw std::out_of_range("seek to " + std::to_string(pos) + " past end of " + std::to_string(_size) + "-byte stream");
+    }
+    _pos = pos;
+    _ext = _find_extent(pos);
+}
+
+void stream_view_t::skip(uint64_t count)
+{
+    _pos += std::min(count, remaining());
+    while (_ext + 1 < _extents.size() and _pos >= _starts[_ext + 1]) {
+        _ext += 1;
+    }
+}
+
+size_t stream_view_t::read(std::byte* dst, size_t count)
+{
+    count = std::min<uint64_t>(count, remaining());
+    size_t done = 0;
+    while (done < count) {
+        const auto& ext = _extents[_ext];
+        uint64_t within = _pos - _starts[_ext];
+        size_t grab = std::min<uint64_t>(count - done, ext.length - within);
+        if (_resident != nullptr) {
+            std::memcpy(dst + done, _resident + ext.offset + within, grab);
+        } else if (_source->read(ext.offset + within, grab, dst + done) != grab) {
+            throw std::runtime_error("short read at source offset " + std::to_string(ext.offset + within));
+        }
+        done += grab;
+        _pos += grab;
+        if (_pos - _starts[_ext] == ext.length and _ext + 1 < _extents.size()) {
+            _ext += 1;
+        }
+    }
+    return done;
+}
+
+data_view_t stream_view_t::peek(size_t count)
+{
+    if (count > remaining()) {
+        throw std::out_of_range(std::to_string(count) + " bytes at stream offset " + std::to_string(_pos)
+            + " exceed stream of " + std::to_string(_size) + " bytes");
+    }
+    if (count == 0) {
+        return {};
+    }
+
+    const auto& ext = _extents[_ext];
+    uint64_t within = _pos - _starts[_ext];
+    if (_resident != nullptr and count <= ext.length - within) {
+        return { _resident + ext.offset + within, count };
+    }
+
+    // straddles extents or the source isn't in memory: gather into scratch
+    uint64_t pos = _pos;
+    size_t ext_index = _ext;
+    _scratch.resize(count);
+    read(_scratch.data(), count);
+    _pos = pos;
+    _ext = ext_index;
+    return { _scratch.data(), count };
+}
+
+data_view_t stream_view_t::next(size_t count)
+{
+    auto result = peek(count);
+    skip(count);
+    return result;
+}
+
+}
@@ -1,8 +1,10 @@
 #include "excelr8/util.hpp"
+#include "excelr8/codec.hpp"
+#include <algorithm>
 #include <cstring>
-#include <iostream>
-#include <unicode/ucnv.h>
-#include <unicode/utypes.h>
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
 #include <vector>
 
 namespace excelr8::util {
@@ -24,31 +26,240 @@ namespace excelr8::util {
     }
     */
 
-dllexport std::string unicode(const data_t& data, const std::string& encoding)
+dllexport std::string unicode(data_view_t data, const std::string& encoding)
 {
-    UErrorCode status = U_ZERO_ERROR;
-    UConverter* conv = ucnv_open(encoding.c_str(), &status);
+    // Resolves the encoding on every call; callers converting many strings
+    // in one encoding should hold on to a codec_t instead
+    return codec_t(encoding).decode(data);
+}
 
-    if (U_SUCCESS(status)) {
-        int32_t utf8Size = ucnv_toUChars(conv, nullptr, 0, (const char*)data.data(), data.size(), &status);
+// Fixed-capacity output: the callers size dst for the worst case, so none
+// of the inner loops check for room.
 
-        if (U_SUCCESS(status)) {
-            std::string utf8Str(utf8Size, '\0');
-            char* utf8Data = utf8Str.data();
-            ucnv_toUChars(conv, reinterpret_cast<UChar*>(utf8Data), utf8Size, reinterpret_cast<const char*>(data.data()), data.size(), &status);
+static inline char* put_code_point(char* dst, char32_t cp)
+{
+    if (cp < 0x80) {
+        *dst++ = static_cast<char>(cp);
+    } else if (cp < 0x800) {
+        *dst++ = static_cast<char>(0xC0 | (cp >> 6));
+        *dst++ = static_cast<char>(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        *dst++ = static_cast<char>(0xE0 | (cp >> 12));
+        *dst++ = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        *dst++ = static_cast<char>(0x80 | (cp & 0x3F));
+    } else {
+        *dst++ = static_cast<char>(0xF0 | (cp >> 18));
+        *dst++ = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        *dst++ = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        *dst++ = static_cast<char>(0x80 | (cp & 0x3F));
+    }
+    return dst;
+}
 
-            ucnv_close(conv);
-            return utf8Str;
+static char* latin1_scalar(const unsigned char* src, size_t n, char* dst)
+{
+    for (size_t i = 0; i < n; i++) {
+        unsigned char c = src[i];
+        if (c < 0x80) {
+            *dst++ = static_cast<char>(c);
         } else {
-            std::cerr << "ucnv_toUChars failed: " << u_errorName(status) << std::endl;
+            *dst++ = static_cast<char>(0xC0 | (c >> 6));
+            *dst++ = static_cast<char>(0x80 | (c & 0x3F));
         }
+    }
+    return dst;
+}
 
-        ucnv_close(conv);
-    } else {
-        std::cerr << "ucnv_open failed: " << u_errorName(status) << std::endl;
+// high is a high surrogate waiting for its pair, or 0
+static char* utf16le_scalar(const unsigned char* src, size_t nunits, char* dst, char16_t& high)
+{
+    const char32_t replacement = 0xFFFD;
+    for (size_t i = 0; i < nunits; i++) {
+        auto unit = static_cast<char16_t>(src[2 * i] | (src[2 * i + 1] << 8));
+        if (high != 0) {
+            if (unit >= 0xDC00 and unit <= 0xDFFF) {
+                dst = put_code_point(dst, 0x10000 + ((high - 0xD800) << 10) + (unit - 0xDC00));
+                high = 0;
+                continue;
+            }
+            dst = put_code_point(dst, replacement);
+            high = 0;
+        }
+        if (unit >= 0xD800 and unit <= 0xDBFF) {
+            high = unit;
+        } else if (unit >= 0xDC00 and unit <= 0xDFFF) {
+            dst = put_code_point(dst, replacement);
+        } else {
+            dst = put_code_point(dst, unit);
+        }
+    }
+    return dst;
+}
+
+#if defined(__x86_64__) || defined(_M_X64)
+// SSE2 is part of x86-64, so these need no dispatch. Most BIFF text is
+// ASCII: a block of it is copied (Latin-1) or narrowed (UTF-16) as is, and
+// any block holding something else goes through the scalar code.
+
+static char* latin1_sse2(const unsigned char* src, size_t n, char* dst)
+{
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        if (_mm_movemask_epi8(v) == 0) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), v);
+            dst += 16;
+        } else {
+            dst = latin1_scalar(src + i, 16, dst);
+        }
     }
+    return latin1_scalar(src + i, n - i, dst);
+}
 
-    return ""; // Return an empty string in case of failure
+static char* utf16le_sse2(const unsigned char* src, size_t nunits, char* dst, char16_t& high)
+{
+    const __m128i non_ascii = _mm_set1_epi16(static_cast<short>(0xFF80));
+    size_t i = 0;
+    for (; i + 8 <= nunits; i += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * i));
+        if (high == 0 and _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(v, non_ascii), _mm_setzero_si128())) == 0xFFFF) {
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(dst), _mm_packus_epi16(v, v));
+            dst += 8;
+        } else {
+            dst = utf16le_scalar(src + 2 * i, 8, dst, high);
+        }
+    }
+    return utf16le_scalar(src + 2 * i, nunits - i, dst, high);
 }
 
-}
\ No newline at end of file
+#if defined(__GNUC__)
+#define EXCELR8_HAVE_AVX2 1
+
+__attribute__((target("avx2"))) static char* latin1_avx2(const unsigned char* src, size_t n, char* dst)
+{
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        if (_mm256_movemask_epi8(v) == 0) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), v);
+            dst += 32;
+        } else {
+            dst = latin1_sse2(src + i, 32, dst);
+        }
+    }
+    return latin1_sse2(src + i, n - i, dst);
+}
+
+__attribute__((target("avx2"))) static char* utf16le_avx2(const unsigned char* src, size_t nunits, char* dst, char16_t& high)
+{
+    const __m256i non_ascii = _mm256_set1_epi16(static_cast<short>(0xFF80));
+    size_t i = 0;
+    for (; i + 16 <= nunits; i += 16) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 2 * i));
+        if (high == 0 and _mm256_testz_si256(v, non_ascii)) {
+            // packus works within 128-bit lanes; gather the two low halves
+            __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(v, v), 0xD8);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm256_castsi256_si128(packed));
+            dst += 16;
+        } else {
+            dst = utf16le_sse2(src + 2 * i, 16, dst, high);
+        }
+    }
+    return utf16le_sse2(src + 2 * i, nunits - i, dst, high);
+}
+#endif
+#endif
+
+dllexport bool cpu_has_avx2()
+{
+#if defined(EXCELR8_HAVE_AVX2)
+    static const bool result = __builtin_cpu_supports("avx2");
+    return result;
+#else
+    return false;
+#endif
+}
+
+dllexport simd_t simd_level()
+{
+    if (cpu_has_avx2()) {
+        return simd_t::avx2;
+    }
+#if defined(__x86_64__) || defined(_M_X64)
+    return simd_t::sse2;
+#else
+    return simd_t::scalar;
+#endif
+}
+
+dllexport size_t latin1_to_utf8(data_view_t src, char* dst, simd_t level)
+{
+    auto in = reinterpret_cast<const unsigned char*>(src.data());
+    switch (std::min(level, simd_level())) {
+#if defined(EXCELR8_HAVE_AVX2)
+    case simd_t::avx2:
+        return latin1_avx2(in, src.size(), dst) - dst;
+#endif
+#if defined(__x86_64__) || defined(_M_X64)
+    case simd_t::sse2:
+        return latin1_sse2(in, src.size(), dst) - dst;
+#endif
+    default:
+        return latin1_scalar(in, src.size(), dst) - dst;
+    }
+}
+
+dllexport size_t latin1_to_utf8(data_view_t src, char* dst)
+{
+    return latin1_to_utf8(src, dst, simd_level());
+}
+
+dllexport size_t utf16le_to_utf8(data_view_t src, char* dst, char16_t* carry, simd_t level)
+{
+    auto in = reinterpret_cast<const unsigned char*>(src.data());
+    size_t nunits = src.size() / 2;
+    char16_t high = carry != nullptr ? *carry : 0;
+    char* end;
+    switch (std::min(level, simd_level())) {
+#if defined(EXCELR8_HAVE_AVX2)
+    case simd_t::avx2:
+        end = utf16le_avx2(in, nunits, dst, high);
+        break;
+#endif
+#if defined(__x86_64__) || defined(_M_X64)
+    case simd_t::sse2:
+        end = utf16le_sse2(in, nunits, dst, high);
+        break;
+#endif
+    default:
+        end = utf16le_scalar(in, nunits, dst, high);
+        break;
+    }
+    if (carry != nullptr) {
+        *carry = high;
+    } else if (high != 0) {
+        end = put_code_point(end, 0xFFFD);
+    }
+    return end - dst;
+}
+
+dllexport size_t utf16le_to_utf8(data_view_t src, char* dst, char16_t* carry)
+{
+    return utf16le_to_utf8(src, dst, carry, simd_level());
+}
+
+dllexport void latin1_to_utf8(data_view_t src, std::string& out)
+{
+    size_t old_size = out.size();
+    out.resize(old_size + latin1_utf8_capacity(src.size()));
+    out.resize(old_size + latin1_to_utf8(src, out.data() + old_size));
+}
+
+dllexport void utf16le_to_utf8(data_view_t src, std::string& out, char16_t* carry)
+{
+    size_t old_size = out.size();
+    out.resize(old_size + utf16le_utf8_capacity(src.size() / 2));
+    out.resize(old_size + utf16le_to_utf8(src, out.data() + old_size, carry));
+}
+
+}
@@ -0,0 +1,374 @@
+/*
+    Differential checks: the vectorized transcoders and RK decoders must
+    give the same bytes as their scalar code paths, and the parallel and
+    lazy SST decoders the same strings as the sequential one.
+
+    Inputs are random (fixed seed) and boundary cases: every length from 0
+    to 65, lone and split surrogates, and RK values with every combination
+    of the integer and x100 flags. Exits non-zero on any mismatch.
+*/
+
+#include "excelr8/record.hpp"
+#include "excelr8/rk.hpp"
+#include "excelr8/sst.hpp"
+#include "excelr8/util.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace excelr8;
+
+static const util::simd_t levels[] = { util::simd_t::scalar, util::simd_t::sse2, util::simd_t::avx2 };
+static const char* level_names[] = { "scalar", "sse2", "avx2" };
+
+static int failures = 0;
+
+static void fail(const std::string& what)
+{
+    std::fprintf(stderr, "FAIL: %s\n", what.c_str());
+    if (++failures >= 20) {
+        std::exit(1);
+    }
+}
+
+static data_view_t view(const std::vector<uint8_t>& bytes)
+{
+    return data_view_t(reinterpret_cast<const std::byte*>(bytes.data()), bytes.size());
+}
+
+static void put_utf8(std::string& out, char32_t cp)
+{
+    if (cp < 0x80) {
+        out += static_cast<char>(cp);
+    } else if (cp < 0x800) {
+        out += static_cast<char>(0xC0 | (cp >> 6));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out += static_cast<char>(0xE0 | (cp >> 12));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (cp >> 18));
+        out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+}
+
+// Reference decoding: unpaired surrogates become U+FFFD
+static std::string reference_utf8(const std::vector<char16_t>& units)
+{
+    std::string out;
+    for (size_t i = 0; i < units.size(); i++) {
+        char16_t u = units[i];
+        if (u >= 0xD800 and u <= 0xDBFF and i + 1 < units.size() and units[i + 1] >= 0xDC00 and units[i + 1] <= 0xDFFF) {
+            put_utf8(out, 0x10000 + ((u - 0xD800) << 10) + (units[i + 1] - 0xDC00));
+            i++;
+        } else if (u >= 0xD800 and u <= 0xDFFF) {
+            put_utf8(out, 0xFFFD);
+        } else {
+            put_utf8(out, u);
+        }
+    }
+    return out;
+}
+
+static std::vector<uint8_t> utf16le_bytes(const std::vector<char16_t>& units, size_t first = 0, size_t last = SIZE_MAX)
+{
+    std::vector<uint8_t> bytes;
+    for (size_t i = first; i < units.size() and i < last; i++) {
+        bytes.push_back(static_cast<uint8_t>(units[i]));
+        bytes.push_back(static_cast<uint8_t>(units[i] >> 8));
+    }
+    return bytes;
+}
+
+// A random unit: mostly ASCII, so the vector fast paths are taken, with
+// Latin-1, BMP and surrogates mixed in
+static char16_t random_unit(std::mt19937& rng, int mix)
+{
+    switch (rng() % 16 < static_cast<unsigned>(mix) ? rng() % 5 : 0) {
+    case 0:
+        return static_cast<char16_t>(0x20 + rng() % 0x5F);
+    case 1:
+        return static_cast<char16_t>(0x80 + rng() % 0x80);
+    case 2:
+        return static_cast<char16_t>(0x100 + rng() % 0xD700);
+    case 3:
+        return static_cast<char16_t>(0xD800 + rng() % 0x400);
+    default:
+        return static_cast<char16_t>(0xDC00 + rng() % 0x400);
+    }
+}
+
+static std::vector<char16_t> random_units(std::mt19937& rng, size_t n, int mix)
+{
+    std::vector<char16_t> units(n);
+    for (auto& u : units) {
+        u = random_unit(rng, mix);
+    }
+    // a well-formed pair somewhere, and one split at the very end
+    if (n >= 2 and rng() % 2) {
+        size_t at = rng() % (n - 1);
+        units[at] = 0xD83D;
+        units[at + 1] = 0xDE00;
+    }
+    if (n >= 1 and rng() % 4 == 0) {
+        units[n - 1] = 0xD83D;
+    }
+    return units;
+}
+
+static std::string transcode(const std::vector<uint8_t>& bytes, bool utf16, char16_t* carry, util::simd_t level)
+{
+    std::string out(utf16 ? util::utf16le_utf8_capacity(bytes.size() / 2) : util::latin1_utf8_capacity(bytes.size()), '\0');
+    size_t n = utf16 ? util::utf16le_to_utf8(view(bytes), out.data(), carry, level) : util::latin1_to_utf8(view(bytes), out.data(), level);
+    out.resize(n);
+    return out;
+}
+
+static void check_transcoders(std::mt19937& rng)
+{
+    for (size_t n = 0; n <= 65; n++) {
+        for (int round = 0; round < 40; round++) {
+            // Latin-1
+            std::vector<uint8_t> latin1(n);
+            for (auto& b : latin1) {
+                b = static_cast<uint8_t>(round % 2 ? rng() : 0x20 + rng() % 0x5F);
+            }
+            std::string expected;
+            for (auto b : latin1) {
+                put_utf8(expected, b);
+            }
+            for (size_t l = 0; l < 3; l++) {
+                if (transcode(latin1, false, nullptr, levels[l]) != expected) {
+                    fail("latin1_to_utf8 " + std::string(level_names[l]) + " length " + std::to_string(n));
+                }
+            }
+
+            // UTF-16LE, whole and split at every point with a carry, as a
+            // string continued in the next record would be
+            auto units = random_units(rng, n, round % 8);
+            auto bytes = utf16le_bytes(units);
+            expected = reference_utf8(units);
+            for (size_t l = 0; l < 3; l++) {
+                if (transcode(bytes, true, nullptr, levels[l]) != expected) {
+                    fail("utf16le_to_utf8 " + std::string(level_names[l]) + " length " + std::to_string(n));
+                }
+                for (size_t split = 0; split <= n; split += round % 4 == 0 ? 1 : 7) {
+                    char16_t carry = 0;
+                    std::string got = transcode(utf16le_bytes(units, 0, split), true, &carry, levels[l]);
+                    got += transcode(utf16le_bytes(units, split), true, &carry, levels[l]);
+                    if (carry != 0) {
+                        put_utf8(got, 0xFFFD);
+                    }
+                    if (got != expected) {
+                        fail("utf16le_to_utf8 " + std::string(level_names[l]) + " length " + std::to_string(n) + " split at " + std::to_string(split));
+                    }
+                }
+            }
+        }
+    }
+}
+
+static void check_rk(std::mt19937& rng)
+{
+    for (size_t stride : { 6u, 10u }) {
+        for (size_t count = 0; count <= 65; count++) {
+            for (int round = 0; round < 20; round++) {
+                std::vector<uint8_t> src(count * stride + 8);
+                for (size_t i = 0; i < count; i++) {
+                    uint32_t rk = static_cast<uint32_t>(rng());
+                    if (round % 3 == 0) {
+                        // small integers and round doubles, with every flag pair
+                        rk = round % 2 ? (static_cast<uint32_t>(static_cast<int32_t>(rng() % 20001) - 10000) << 2) : 0x3FF00000u + (rng() % 64 << 20);
+                        rk = (rk & ~3u) | static_cast<uint32_t>(i % 4);
+                    }
+                    uint16_t xf = static_cast<uint16_t>(rng());
+                    std::memcpy(&src[i * stride], &xf, 2);
+                    std::memcpy(&src[i * stride + 2], &rk, 4);
+                }
+                std::vector<double> expected(count);
+                std::vector<uint16_t> expected_xf(count);
+                for (size_t i = 0; i < count; i++) {
+                    uint32_t rk;
+                    std::memcpy(&expected_xf[i], &src[i * stride], 2);
+                    std::memcpy(&rk, &src[i * stride + 2], 4);
+                    expected[i] = biff::rk_to_double(rk);
+                }
+                for (size_t l = 0; l < 3; l++) {
+                    std::vector<double> values(count);
+                    std::vector<uint16_t> xf_indexes(count);
+                    biff::unpack_rk_run(reinterpret_cast<const std::byte*>(src.data()), count, stride, values.data(), xf_indexes.data(), levels[l]);
+                    // bit-identical, NaNs included
+                    if (std::memcmp(values.data(), expected.data(), count * sizeof(double)) != 0 or xf_indexes != expected_xf) {
+                        fail("unpack_rk_run " + std::string(level_names[l]) + " count " + std::to_string(count) + " stride " + std::to_string(stride));
+                    }
+                }
+            }
+        }
+    }
+}
+
+// An SST record, its CONTINUEs and EXTSST, as a BIFF stream; the strings
+// are split across records at random, as writers do
+struct sst_stream_t {
+    std::vector<uint8_t> bytes;
+    std::vector<std::string> expected;
+};
+
+static sst_stream_t build_sst(std::mt19937& rng, size_t nstrings, uint16_t dsst)
+{
+    std::vector<std::vector<uint8_t>> segments(1);
+    std::vector<std::pair<size_t, size_t>> buckets; // segment, offset
+    auto put16 = [](std::vector<uint8_t>& seg, uint32_t v) {
+        seg.push_back(static_cast<uint8_t>(v));
+        seg.push_back(static_cast<uint8_t>(v >> 8));
+    };
+    auto put32 = [&](std::vector<uint8_t>& seg, uint32_t v) {
+        put16(seg, v & 0xFFFF);
+        put16(seg, v >> 16);
+    };
+    put32(segments[0], static_cast<uint32_t>(nstrings));
+    put32(segments[0], static_cast<uint32_t>(nstrings));
+    size_t max = 100 + rng() % 8124;
+    auto room = [&] { return max > segments.back().size() ? max - segments.back().size() : 0; };
+    auto new_segment = [&] {
+        segments.emplace_back();
+        max = 100 + rng() % 8124;
+    };
+
+    sst_stream_t result;
+    for (size_t idx = 0; idx < nstrings; idx++) {
+        auto units = random_units(rng, rng() % 8 == 0 ? rng() % 400 : rng() % 30, static_cast<int>(idx % 8));
+        bool compressed = true;
+        for (auto u : units) {
+            compressed = compressed and u < 0x100;
+        }
+        result.expected.push_back(reference_utf8(units));
+        bool rich = idx % 7 == 0, phonetic = idx % 11 == 0;
+
+        std::vector<uint8_t> header;
+        put16(header, static_cast<uint32_t>(units.size()));
+        header.push_back(static_cast<uint8_t>((compressed ? 0 : 1) | (rich ? 8 : 0) | (phonetic ? 4 : 0)));
+        if (rich) {
+            put16(header, 2);
+        }
+        if (phonetic) {
+            put32(header, 10);
+        }
+        if (room() < header.size() + 2) {
+            new_segment();
+        }
+        if (idx % dsst == 0) {
+            buckets.push_back({ segments.size() - 1, segments.back().size() });
+        }
+        segments.back().insert(segments.back().end(), header.begin(), header.end());
+
+        size_t width = compressed ? 1 : 2;
+        for (size_t i = 0; i < units.size();) {
+            size_t n = std::min(room() / width, units.size() - i);
+            for (size_t k = i; k < i + n; k++) {
+                if (width == 1) {
+                    segments.back().push_back(static_cast<uint8_t>(units[k]));
+                } else {
+                    put16(segments.back(), units[k]);
+                }
+            }
+            i += n;
+            if (i < units.size()) {
+                // the rest goes in the next record, behind its own flags byte
+                new_segment();
+                if (compressed) {
+                    width = rng() % 2 ? 1 : 2;
+                }
+                segments.back().push_back(width == 1 ? 0 : 1);
+            }
+        }
+        size_t tail = (rich ? 8 : 0) + (phonetic ? 10 : 0);
+        for (size_t i = 0; i < tail; i++) {
+            if (room() == 0) {
+                new_segment();
+            }
+            segments.back().push_back(0x01);
+        }
+    }
+
+    // BOF, SST, CONTINUE..., EXTSST, EOF
+    auto& out = result.bytes;
+    auto put_record = [&](uint16_t opcode, const std::vector<uint8_t>& payload) {
+        put16(out, opcode);
+        put16(out, static_cast<uint32_t>(payload.size()));
+        out.insert(out.end(), payload.begin(), payload.end());
+    };
+    put_record(biff::XL_BOF, { 0, 6, 0x10, 0 });
+    std::vector<size_t> header_pos;
+    for (size_t k = 0; k < segments.size(); k++) {
+        header_pos.push_back(out.size());
+        put_record(k == 0 ? biff::XL_SST : biff::XL_CONTINUE, segments[k]);
+    }
+    std::vector<uint8_t> extsst;
+    put16(extsst, dsst);
+    for (auto [k, offset] : buckets) {
+        put32(extsst, static_cast<uint32_t>(header_pos[k] + 4 + offset));
+        put16(extsst, static_cast<uint32_t>(4 + offset));
+        put16(extsst, 0);
+    }
+    put_record(biff::XL_EXTSST, extsst);
+    put_record(biff::XL_EOF, {});
+    return result;
+}
+
+static void check_sst(std::mt19937& rng)
+{
+    auto sst = build_sst(rng, 40000, 8);
+    biff::record_cursor_t cursor(view(sst.bytes));
+    cursor.next();
+    auto rec = cursor.next_joined();
+    if (rec->payload.size() < book::sst_parallel_min_size) {
+        fail("SST payload too small to be decoded in parallel");
+    }
+    auto ext = cursor.next();
+    std::vector<std::byte> extsst(ext->payload.begin(), ext->payload.end());
+    auto check = [&](const book::sst_t& table, const std::string& what) {
+        if (table.size() != sst.expected.size()) {
+            fail(what + ": " + std::to_string(table.size()) + " strings");
+            return;
+        }
+        for (size_t i = 0; i < sst.expected.size(); i++) {
+            if (table[i] != sst.expected[i]) {
+                fail(what + ": string " + std::to_string(i));
+                return;
+            }
+        }
+    };
+    data_view_t payload = rec->payload;
+    data_view_t extsst_view(extsst.data(), extsst.size());
+    for (unsigned nthreads : { 1u, 2u, 4u, 16u }) {
+        check(book::unpack_sst_table(payload, cursor.segments(), extsst_view, rec->offset, nthreads), "unpack_sst_table nthreads=" + std::to_string(nthreads));
+    }
+    // an EXTSST that doesn't agree with the SST falls back to one thread
+    extsst[10] ^= std::byte { 1 };
+    check(book::unpack_sst_table(payload, cursor.segments(), extsst_view, rec->offset, 4), "unpack_sst_table with a bad EXTSST");
+    check(book::index_sst_table(payload, cursor.segments()), "index_sst_table");
+}
+
+int main()
+{
+    std::mt19937 rng(20241017);
+    std::printf("SIMD level: %s\n", level_names[static_cast<int>(util::simd_level())]);
+    check_transcoders(rng);
+    check_rk(rng);
+    check_sst(rng);
+    if (failures != 0) {
+        std::printf("%d mismatches\n", failures);
+        return 1;
+    }
+    std::printf("all code paths agree\n");
+    return 0;
+}